@@ -146,6 +146,7 @@ public:
   bool RerollLoops;
   bool LoadCombine;
   bool NewGVN;
+  bool SSAPRE;
   bool DisableGVNLoadPRE;
   bool VerifyInput;
   bool VerifyOutput;
@@ -45,6 +45,9 @@ class GVNLegacyPass;
 /// this particular pass here.
 class GVN : public PassInfoMixin<GVN> {
 public:
+  /// With \p NoPRE set neither scalar nor load PRE is done, a separate PRE
+  /// pass(e.g. SSAPRE) is expected to run instead.
+  explicit GVN(bool NoPRE = false) : NoPRE(NoPRE) {}
 
   /// \brief Run the pass over the function.
   PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
@@ -106,6 +109,7 @@ private:
   friend class gvn::GVNLegacyPass;
   friend struct DenseMapInfo<Expression>;
 
+  bool NoPRE;
   MemoryDependenceResults *MD;
   DominatorTree *DT;
   const TargetLibraryInfo *TLI;
@@ -229,8 +233,8 @@ private:
 };
 
 /// Create a legacy GVN pass. This also allows parameterizing whether or not
-/// loads are eliminated by the pass.
-FunctionPass *createGVNPass(bool NoLoads = false);
+/// loads are eliminated by the pass and whether or not PRE is done.
+FunctionPass *createGVNPass(bool NoLoads = false, bool NoPRE = false);
 
 /// \brief A simple and fast domtree-based GVN pass to hoist common expressions
 /// from sibling branches.
@@ -16,13 +16,26 @@
 #define LLVM_TRANSFORMS_SCALAR_SSAPRE_H
 
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/Analysis/OptimizationDiagnosticInfo.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Support/ArrayRecycler.h"
 #include "llvm/Support/Allocator.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Transforms/Utils/MemorySSA.h"
+#include "llvm/Transforms/Utils/MemorySSAUpdater.h"
+#include <array>
+#include <memory>
+#include <mutex>
 #include <stack>
 
 namespace llvm {
@@ -52,11 +65,12 @@ enum ExpressionType {
   ET_BasicStart,
   ET_Basic,
   ET_Phi,
-  // TODO later
-  // ET_Call,
-  // ET_AggregateValue,
-  // ET_Load,
+  ET_AggregateValue,
+  ET_MemoryStart,
+  ET_Load,
+  ET_Call,
   // ET_Store,
+  ET_MemoryEnd,
   ET_BasicEnd
 
 };
@@ -69,6 +83,9 @@ inline std::string ExpressionTypeToString(ExpressionType ET) {
   case ET_Unknown:   return "ExpressionTypeUnknown";
   case ET_Basic:     return "ExpressionTypeBasic";
   case ET_Phi:       return "ExpressionTypePhi";
+  case ET_AggregateValue: return "ExpressionTypeAggregateValue";
+  case ET_Load:      return "ExpressionTypeLoad";
+  case ET_Call:      return "ExpressionTypeCall";
   case ET_Factor:    return "ExpressionTypeFactor";
   case ET_Variable:  return "ExpressionTypeVariable";
   case ET_Constant:  return "ExpressionTypeConstant";
@@ -96,6 +113,7 @@ private:
   unsigned Opcode;
   ExpVersion_t Version;
 
+  // The first occurrence of the Prototype, not owned
   Instruction *Proto;
 
   int Saved;
@@ -155,6 +173,12 @@ public:
     return false;
   }
 
+  // Structural hash, must agree with equals: expressions that are equal must
+  // produce the same hash value
+  virtual hash_code getHashValue() const {
+    return hash_combine(EType, Opcode, Version);
+  }
+
   virtual void printInternal(raw_ostream &OS) const {
     OS << ExpressionTypeToString(getExpressionType());
     OS << ", V: " << Version;
@@ -194,6 +218,10 @@ public:
     return false;
   }
 
+  hash_code getHashValue() const override {
+    return hash_combine(this->Expression::getHashValue(), Inst);
+  }
+
   void printInternal(raw_ostream &OS) const override {
     this->Expression::printInternal(OS);
   }
@@ -236,6 +264,10 @@ public:
     return false;
   }
 
+  hash_code getHashValue() const override {
+    return hash_combine(getExpressionType(), &VariableValue);
+  }
+
   void printInternal(raw_ostream &OS) const override {
     this->Expression::printInternal(OS);
     OS << ", V: " << VariableValue;
@@ -266,6 +298,10 @@ public:
     return false;
   }
 
+  hash_code getHashValue() const override {
+    return hash_combine(getExpressionType(), &ConstantValue);
+  }
+
   void printInternal(raw_ostream &OS) const override {
     this->Expression::printInternal(OS);
     OS << ", C:" << ConstantValue;
@@ -274,12 +310,16 @@ public:
 
 class BasicExpression : public Expression {
 private:
-  SmallVector<Value *, 2> Operands; // TODO use Expressions here
+  // Allocated from the expression allocator, the destructor is never run
+  Value **Operands; // TODO use Expressions here
+  unsigned NumOperands;
+  unsigned MaxOperands;
   Type *ValueType;
 
 public:
   BasicExpression(ExpressionType ET = ET_Basic)
-      : Expression(ET), ValueType(nullptr) {}
+      : Expression(ET), Operands(nullptr), NumOperands(0), MaxOperands(0),
+        ValueType(nullptr) {}
   BasicExpression(const BasicExpression &) = delete;
   BasicExpression &operator=(const BasicExpression &) = delete;
   ~BasicExpression() override;
@@ -289,24 +329,30 @@ public:
     return ET > ET_BasicStart && ET < ET_BasicEnd;
   }
 
+  void allocateOperands(BumpPtrAllocator &Allocator, unsigned N) {
+    assert(!Operands && "Operands are already allocated");
+    Operands = Allocator.Allocate<Value *>(N);
+    MaxOperands = N;
+  }
   void addOperand(Value *V) {
-    Operands.push_back(V);
+    assert(NumOperands < MaxOperands && "Operands are not allocated");
+    Operands[NumOperands++] = V;
   }
   Value *getOperand(unsigned N) const {
     return Operands[N];
   }
   void setOperand(unsigned N, Value *V) {
-    assert(N < Operands.size() && "Operand out of range");
+    assert(N < NumOperands && "Operand out of range");
     Operands[N] = V;
   }
   void swapOperands(unsigned First, unsigned Second) {
     std::swap(Operands[First], Operands[Second]);
   }
-  const SmallVector<Value *, 2>& getOperands() const {
-    return Operands;
+  ArrayRef<Value *> getOperands() const {
+    return ArrayRef<Value *>(Operands, NumOperands);
   }
 
-  unsigned getNumOperands() const { return Operands.size(); }
+  unsigned getNumOperands() const { return NumOperands; }
 
   void setType(Type *T) { ValueType = T; }
   Type *getType() const { return ValueType; }
@@ -316,11 +362,16 @@ public:
       return false;
 
     if (auto OE = dyn_cast<BasicExpression>(&O)) {
-      return getType() == OE->getType() && Operands == OE->Operands;
+      return getType() == OE->getType() && getOperands() == OE->getOperands();
     }
     return false;
   }
 
+  hash_code getHashValue() const override {
+    return hash_combine(this->Expression::getHashValue(), ValueType,
+                        hash_combine_range(Operands, Operands + NumOperands));
+  }
+
   void printInternal(raw_ostream &OS) const override {
     this->Expression::printInternal(OS);
     OS << ", OPS: " << getNumOperands();
@@ -365,6 +416,10 @@ public:
     return false;
   }
 
+  hash_code getHashValue() const override {
+    return hash_combine(this->BasicExpression::getHashValue(), BB);
+  }
+
   void printInternal(raw_ostream &OS) const override {
     this->BasicExpression::printInternal(OS);
     OS << ", BB: ";
@@ -372,6 +427,216 @@ public:
   }
 }; // class PHIExpression
 
+// ExtractValue and InsertValue, the index list is a part of the Expression's
+// identity. The indices live in the pass' expression allocator.
+class AggregateValueExpression final : public BasicExpression {
+private:
+  unsigned *IntOperands;
+  unsigned NumIntOperands;
+
+public:
+  AggregateValueExpression(unsigned *IntOperands, unsigned NumIntOperands)
+    : BasicExpression(ET_AggregateValue), IntOperands(IntOperands),
+      NumIntOperands(NumIntOperands) {}
+  AggregateValueExpression() = delete;
+  AggregateValueExpression(const AggregateValueExpression &) = delete;
+  AggregateValueExpression &
+  operator=(const AggregateValueExpression &) = delete;
+  ~AggregateValueExpression() override;
+
+  ArrayRef<unsigned> getIntOperands() const {
+    return ArrayRef<unsigned>(IntOperands, NumIntOperands);
+  }
+
+  static bool classof(const Expression *EB) {
+    return EB->getExpressionType() == ET_AggregateValue;
+  }
+
+  bool equals(const Expression &O) const override {
+    if (!this->BasicExpression::equals(O))
+      return false;
+    if (auto OE = dyn_cast<AggregateValueExpression>(&O)) {
+      return getIntOperands() == OE->getIntOperands();
+    }
+    return false;
+  }
+
+  hash_code getHashValue() const override {
+    return hash_combine(this->BasicExpression::getHashValue(),
+                        hash_combine_range(IntOperands,
+                                           IntOperands + NumIntOperands));
+  }
+
+  void printInternal(raw_ostream &OS) const override {
+    this->BasicExpression::printInternal(OS);
+    OS << ", IDX:";
+    for (unsigned i = 0; i < NumIntOperands; ++i)
+      OS << " " << IntOperands[i];
+  }
+}; // class AggregateValueExpression
+
+// Base of the Expressions that may read memory
+class MemoryExpression : public BasicExpression {
+private:
+  // The nearest access that may clobber the memory the Expression reads, null
+  // if it does not read any. It is not a part of the Expression's identity,
+  // all occurrences of the same class share one Prototype and this access
+  // tells their versions apart.
+  MemoryAccess *ClobberingAccess;
+
+public:
+  MemoryExpression(ExpressionType ET, MemoryAccess *MA)
+    : BasicExpression(ET), ClobberingAccess(MA) {}
+  MemoryExpression() = delete;
+  MemoryExpression(const MemoryExpression &) = delete;
+  MemoryExpression &operator=(const MemoryExpression &) = delete;
+  ~MemoryExpression() override;
+
+  MemoryAccess *getClobberingAccess() const { return ClobberingAccess; }
+  void setClobberingAccess(MemoryAccess *MA) { ClobberingAccess = MA; }
+
+  static bool classof(const Expression *EB) {
+    ExpressionType ET = EB->getExpressionType();
+    return ET > ET_MemoryStart && ET < ET_MemoryEnd;
+  }
+
+  void printInternal(raw_ostream &OS) const override {
+    this->BasicExpression::printInternal(OS);
+    OS << ", MA: ";
+    if (ClobberingAccess)
+      OS << *ClobberingAccess;
+    else
+      OS << "none";
+  }
+}; // class MemoryExpression
+
+class LoadExpression final : public MemoryExpression {
+private:
+  unsigned Alignment;
+
+public:
+  LoadExpression(unsigned Alignment, MemoryAccess *MA)
+    : MemoryExpression(ET_Load, MA), Alignment(Alignment) {}
+  LoadExpression() = delete;
+  LoadExpression(const LoadExpression &) = delete;
+  LoadExpression &operator=(const LoadExpression &) = delete;
+  ~LoadExpression() override;
+
+  unsigned getAlignment() const { return Alignment; }
+
+  static bool classof(const Expression *EB) {
+    return EB->getExpressionType() == ET_Load;
+  }
+
+  bool equals(const Expression &O) const override {
+    if (!this->BasicExpression::equals(O))
+      return false;
+    if (auto OE = dyn_cast<LoadExpression>(&O)) {
+      return Alignment == OE->Alignment;
+    }
+    return false;
+  }
+
+  hash_code getHashValue() const override {
+    return hash_combine(this->BasicExpression::getHashValue(), Alignment);
+  }
+}; // class LoadExpression
+
+// A call without side effects, the callee is its last operand. Calls that only
+// read memory are versioned by MemorySSA the same way loads are.
+class CallExpression final : public MemoryExpression {
+public:
+  CallExpression(MemoryAccess *MA) : MemoryExpression(ET_Call, MA) {}
+  CallExpression() = delete;
+  CallExpression(const CallExpression &) = delete;
+  CallExpression &operator=(const CallExpression &) = delete;
+  ~CallExpression() override;
+
+  static bool classof(const Expression *EB) {
+    return EB->getExpressionType() == ET_Call;
+  }
+}; // class CallExpression
+
+// Predecessors of a join block. Every Factor of the block shares the same
+// instance, which maps predecessor blocks onto Factor operand indices. All the
+// storage comes from the pass' expression allocator.
+class FactorPredecessors {
+private:
+  // Unique predecessors in pred_begin/pred_end order
+  BasicBlock **Blocks;
+  // Number of edges coming from each predecessor
+  unsigned *Mult;
+  unsigned NumBlocks;
+  unsigned NumEdges;
+
+  // Open-addressing Block-to-Index table, its size is a power of two
+  const BasicBlock **Keys;
+  unsigned *Indices;
+  unsigned TableMask;
+
+public:
+  FactorPredecessors(BasicBlock **Blocks, unsigned *Mult, unsigned NumBlocks,
+                     unsigned NumEdges, const BasicBlock **Keys,
+                     unsigned *Indices, unsigned TableSize)
+      : Blocks(Blocks), Mult(Mult), NumBlocks(NumBlocks), NumEdges(NumEdges),
+        Keys(Keys), Indices(Indices), TableMask(TableSize - 1) {
+    assert(isPowerOf2_32(TableSize) && TableSize > NumBlocks);
+    rehash();
+  }
+  FactorPredecessors() = delete;
+  FactorPredecessors(const FactorPredecessors &) = delete;
+  FactorPredecessors &operator=(const FactorPredecessors &) = delete;
+
+  // Index of a block that is not a predecessor
+  static constexpr size_t NotFound = static_cast<size_t>(-1);
+
+  // Table size for the number of unique predecessors, keeps load under 1/2
+  static unsigned getTableSize(unsigned NumBlocks) {
+    return NextPowerOf2(2 * NumBlocks);
+  }
+
+  size_t size() const { return NumBlocks; }
+  size_t getNumEdges() const { return NumEdges; }
+
+  ArrayRef<BasicBlock *> getBlocks() const {
+    return makeArrayRef(Blocks, NumBlocks);
+  }
+  BasicBlock * getBlock(size_t I) const { return Blocks[I]; }
+  unsigned getMult(size_t I) const { return Mult[I]; }
+
+  // Returns NotFound if B is not a predecessor
+  size_t getIndex(const BasicBlock *B) const {
+    auto S = getSlot(B);
+    return Keys[S] ? Indices[S] : NotFound;
+  }
+
+  // The edge from Old was split by New, it takes Old's index so the operands
+  // of every Factor of the block stay in place
+  void replace(const BasicBlock *Old, BasicBlock *New) {
+    auto I = getIndex(Old);
+    assert(I != NotFound && "Not a predecessor");
+    Blocks[I] = New;
+    rehash();
+  }
+
+private:
+  void rehash() {
+    for (unsigned i = 0; i <= TableMask; ++i) Keys[i] = nullptr;
+    for (unsigned i = 0; i < NumBlocks; ++i) {
+      auto S = getSlot(Blocks[i]);
+      Keys[S] = Blocks[i];
+      Indices[S] = i;
+    }
+  }
+
+  // Returns the slot of B or the empty slot B would be placed into
+  unsigned getSlot(const BasicBlock *B) const {
+    unsigned S = DenseMapInfo<const BasicBlock *>::getHashValue(B) & TableMask;
+    while (Keys[S] && Keys[S] != B) S = (S + 1) & TableMask;
+    return S;
+  }
+}; // class FactorPredecessors
+
 class FactorExpression final : public Expression {
 private:
   const BasicBlock &BB;
@@ -380,16 +645,11 @@ private:
   // Proto
   const Expression *PE;
 
-  // This maps BB to Index inside Versions and HRU
-  SmallPtrSet<BasicBlock *, 4> Blocks;
-  DenseMap<BasicBlock *, size_t> Pred;
-  DenseMap<size_t, BasicBlock *> Indices;
-
-  DenseMap<BasicBlock *, size_t> PredMult;
-  size_t TotalPredecessors;
+  // Predecessors of BB, operands below are indexed the same way
+  const FactorPredecessors &Preds;
 
   // The Versioned Expressions that this Factor joins
-  SmallVector<Expression *, 8> Versions;
+  Expression **Versions;
 
   // If True this Factor is linked to already existing PHI function
   bool Materialized;
@@ -405,103 +665,136 @@ private:
   // The second course of actions would be to push the computation directly to
   // the first use place, but we need to prove that this place is not inside a
   // cycle, or at least in the same cycle as init.
-  SmallVector<bool, 8> Cycles;
+  //
+  // One bit per operand.
+  uint64_t *Cycles;
 
   // If True expression is Anticipated on every path leading from this Factor
   bool DownSafe;
 
   // True if an Operand is a Real expression and not Factor or Expression
-  // Operand definition(⊥)
-  SmallVector<bool, 8> HasRealUse;
+  // Operand definition(⊥). One bit per operand.
+  uint64_t *HasRealUse;
 
   bool CanBeAvail;
   bool Later;
 
+  // If True the Factor is DownSafe only by assumption, either the minimum cut
+  // made it available or its computation is cheap and safe to speculate.
+  // Insertions into its predecessors must not rely on the value being
+  // anticipated.
+  bool Speculative;
+
+  static bool getBit(const uint64_t *W, size_t I) {
+    return W[I / 64] & (1ULL << (I % 64));
+  }
+  static void setBit(uint64_t *W, size_t I, bool V) {
+    if (V)
+      W[I / 64] |= 1ULL << (I % 64);
+    else
+      W[I / 64] &= ~(1ULL << (I % 64));
+  }
+
+  size_t getIndex(const BasicBlock *B) const {
+    auto I = Preds.getIndex(B);
+    assert(I != FactorPredecessors::NotFound && "Not a predecessor");
+    return I;
+  }
+
 public:
-  FactorExpression(const BasicBlock &BB)
-      : Expression(ET_Factor), BB(BB), TotalPredecessors(0),
-                   Materialized(false),
+  // Versions must hold Preds.size() entries, Cycles and HasRealUse must hold
+  // getNumBitWords(Preds.size()) words each
+  FactorExpression(const BasicBlock &BB, const FactorPredecessors &Preds,
+                   Expression **Versions, uint64_t *Cycles,
+                   uint64_t *HasRealUse)
+      : Expression(ET_Factor), BB(BB), Preds(Preds), Versions(Versions),
+                   Materialized(false), Cycles(Cycles),
                    // These initializations must not change
-                   DownSafe(true), CanBeAvail(true), Later(false) {}
+                   DownSafe(true), HasRealUse(HasRealUse),
+                   CanBeAvail(true), Later(false), Speculative(false) {
+    auto N = Preds.size();
+    for (size_t i = 0; i < N; ++i) Versions[i] = nullptr;
+    for (size_t i = 0, l = getNumBitWords(N); i < l; ++i)
+      Cycles[i] = HasRealUse[i] = 0;
+  }
   FactorExpression() = delete;
   FactorExpression(const FactorExpression &) = delete;
   FactorExpression &operator=(const FactorExpression &) = delete;
   ~FactorExpression() override;
 
+  static size_t getNumBitWords(size_t N) { return (N + 63) / 64; }
+
   const BasicBlock * getBB() const { return &BB; }
 
   void setIsMaterialized(bool L) { Materialized = L; }
   bool getIsMaterialized() const { return Materialized; }
 
   bool getAnyCycles() const {
-    for (auto C : Cycles) {
-      if (C) return true;
+    for (size_t i = 0, l = getNumBitWords(Preds.size()); i < l; ++i) {
+      if (Cycles[i]) return true;
     }
     return false;
   }
-  bool getIsCycle(Expression *E) const {
-    assert(E && hasVExpr(E));
-    return Cycles[getVExprIndex(E)];
+  bool getIsCycleAt(size_t I) const { return getBit(Cycles, I); }
+  void setIsCycleAt(size_t I, bool CYC) { setBit(Cycles, I, CYC); }
+  bool getIsCycle(const BasicBlock *B) const {
+    return getIsCycleAt(getIndex(B));
   }
-  void setIsCycle(Expression *E, bool CYC) {
-    assert(E && hasVExpr(E));
-    Cycles[getVExprIndex(E)] = CYC;
+  void setIsCycle(const BasicBlock *B, bool CYC) {
+    setIsCycleAt(getIndex(B), CYC);
   }
 
   void setPExpr(const Expression *E) { PE = E; }
   const Expression* getPExpr() const { return PE; }
 
-  void addPred(BasicBlock *B, size_t I) {
-    // Even if there are multiple edges from the same predecessor we store only
-    // once
-    TotalPredecessors++;
-
-    if (Pred.count(B)) {
-      PredMult[B]++;
-      return;
-    }
-
-    Pred[B] = I;
-    PredMult[B] = 1;
-    Indices[I] = B;
-    Blocks.insert(B);
-    Versions.push_back(nullptr);
-    Cycles.push_back(false);
-    HasRealUse.push_back(false);
-  }
-
-  size_t GetPredMult(BasicBlock * B) {
+  size_t GetPredMult(const BasicBlock * B) const {
     assert(B);
-    return PredMult[B];
+    return Preds.getMult(getIndex(B));
   }
 
-  const SmallPtrSet<BasicBlock *, 4> &getPreds() { return Blocks; }
+  ArrayRef<BasicBlock *> getPreds() const { return Preds.getBlocks(); }
 
-  void setVExpr(BasicBlock *B, Expression * V) { Versions[Pred[B]] = V; }
+  void setVExpr(const BasicBlock *B, Expression * V) {
+    Versions[getIndex(B)] = V;
+  }
 
+  // Replace every operand E with V
   void replaceVExpr(Expression *E, Expression *V) {
     assert(hasVExpr(E));
-    Versions[getVExprIndex(E)] = V;
+    for (size_t i = 0, l = Preds.size(); i < l; ++i) {
+      if (Versions[i] == E) Versions[i] = V;
+    }
   }
 
-  bool hasVExpr(const Expression *V) const { return getVExprIndex(V) != -1UL; }
-  SmallVector<Expression *, 8> &getVExprs() { return Versions; };
-  Expression * getVExpr(BasicBlock *B) const { return Versions[Pred.lookup(B)]; }
+  bool hasVExpr(const Expression *V) const {
+    return getVExprIndex(V) != FactorPredecessors::NotFound;
+  }
+  MutableArrayRef<Expression *> getVExprs() const {
+    return MutableArrayRef<Expression *>(Versions, Preds.size());
+  }
+  Expression * getVExprAt(size_t I) const { return Versions[I]; }
+  void setVExprAt(size_t I, Expression *V) { Versions[I] = V; }
+  Expression * getVExpr(const BasicBlock *B) const {
+    return Versions[getIndex(B)];
+  }
 
-  size_t getVExprNum() const { return Versions.size(); }
-  size_t getTotalPredecessors() const { return TotalPredecessors; }
+  size_t getVExprNum() const { return Preds.size(); }
+  size_t getTotalPredecessors() const { return Preds.getNumEdges(); }
   size_t getVExprIndex(const Expression *V) const  {
     assert(V);
-    for(size_t i = 0, l = Versions.size(); i < l; ++i) {
+    for(size_t i = 0, l = Preds.size(); i < l; ++i) {
       if (Versions[i] == V)
         return i;
     }
-    return -1;
+    return FactorPredecessors::NotFound;
   }
 
   bool getDownSafe() const { return DownSafe; }
   void setDownSafe(bool DS) { DownSafe = DS; }
 
+  bool getSpeculative() const { return Speculative; }
+  void setSpeculative(bool S) { Speculative = S; }
+
   bool getCanBeAvail() const { return CanBeAvail; }
   void setCanBeAvail(bool CBA) { CanBeAvail = CBA; }
 
@@ -513,13 +806,13 @@ public:
 
   bool getWillBeAvail() const { return CanBeAvail && !Later; }
 
-  bool getHasRealUse(Expression *E) const {
-    assert(E && hasVExpr(E));
-    return HasRealUse[getVExprIndex(E)];
+  bool getHasRealUseAt(size_t I) const { return getBit(HasRealUse, I); }
+  void setHasRealUseAt(size_t I, bool HRU) { setBit(HasRealUse, I, HRU); }
+  bool getHasRealUse(const BasicBlock *B) const {
+    return getHasRealUseAt(getIndex(B));
   }
-  void setHasRealUse(Expression *E, bool HRU) {
-    assert(E && hasVExpr(E));
-    HasRealUse[getVExprIndex(E)] = HRU;
+  void setHasRealUse(const BasicBlock *B, bool HRU) {
+    setHasRealUseAt(getIndex(B), HRU);
   }
 
   static bool classof(const Expression *EB) {
@@ -536,34 +829,39 @@ public:
     return false;
   }
 
+  hash_code getHashValue() const override {
+    return hash_combine(this->Expression::getHashValue(), &BB);
+  }
+
   void printInternal(raw_ostream &OS) const override {
     this->Expression::printInternal(OS);
+    auto N = Preds.size();
     OS << ", BB: ";
     BB.printAsOperand(OS, false);
     OS << ", PE: " << (void *)PE;
     OS << ", MAT: " << Materialized;
     OS << ", DS: " << (DownSafe ? "T" : "F");
+    OS << ", SPEC: " << (Speculative ? "T" : "F");
     OS << ", CBA: " << (CanBeAvail ? "T" : "F");
     OS << ", L: " << (Later ? "T" : "F");
     OS << ", WBA: " << (getWillBeAvail() ? "T" : "F");
     OS << ", CYC: <";
-    for (unsigned i = 0, l = Cycles.size(); i < l; ++i) {
-      OS << (Cycles[i] ? "T" : "F");
-      if (i + 1 != l) OS << ",";
+    for (unsigned i = 0; i < N; ++i) {
+      OS << (getIsCycleAt(i) ? "T" : "F");
+      if (i + 1 != N) OS << ",";
     }
     OS << ">";
     OS << ", HRU: <";
-    for (unsigned i = 0, l = HasRealUse.size(); i < l; ++i) {
-      OS << (HasRealUse[i] ? "T" : "F");
-      if (i + 1 != l) OS << ",";
+    for (unsigned i = 0; i < N; ++i) {
+      OS << (getHasRealUseAt(i) ? "T" : "F");
+      if (i + 1 != N) OS << ",";
     }
     OS << ">";
     OS << ", V: {";
-    for (unsigned i = 0, l = Versions.size(); i < l; ++i) {
-      auto B = Indices.lookup(i);
-      B->printAsOperand(dbgs());
+    for (unsigned i = 0; i < N; ++i) {
+      Preds.getBlock(i)->printAsOperand(dbgs());
       OS << ":";
-      auto VE = getVExpr(B);
+      auto VE = Versions[i];
       if (VE) {
         if (VE->getVersion() == VR_Bottom) {
           OS << "⊥";
@@ -579,33 +877,117 @@ public:
       } else {
         OS << "×";
       }
-      if (i + 1 != l) OS << ",";
+      if (i + 1 != N) OS << ",";
     }
     OS << "}";
   }
 }; // class FactorExpression
 
+// Hash-consing info for Prototype Expressions. Everywhere else in the pass
+// Expressions are compared by identity, this one is used only to find an
+// already existing structurally equal Prototype.
+struct ProtoExpressionInfo {
+  static const Expression *getEmptyKey() {
+    return DenseMapInfo<const Expression *>::getEmptyKey();
+  }
+  static const Expression *getTombstoneKey() {
+    return DenseMapInfo<const Expression *>::getTombstoneKey();
+  }
+  static unsigned getHashValue(const Expression *E) {
+    return static_cast<unsigned>(E->getHashValue());
+  }
+  static bool isEqual(const Expression *LHS, const Expression *RHS) {
+    if (LHS == RHS)
+      return true;
+    if (LHS == getEmptyKey() || LHS == getTombstoneKey() ||
+        RHS == getEmptyKey() || RHS == getTombstoneKey())
+      return false;
+    return LHS->equals(*RHS);
+  }
+};
+
 } // end namespace ssapre
 
 using namespace ssapre;
 
 typedef SmallVector<BasicBlock *, 32> BBVector_t;
 typedef SmallVector<FactorExpression *, 32> FEVector_t;
+typedef SmallVector<std::pair<FactorExpression *, size_t>, 4> FactorUseVector_t;
 typedef std::pair<unsigned, Expression *> UIntExpressionPair_t;
 typedef std::stack<UIntExpressionPair_t> ExprStack_t;
 typedef SmallVector<Expression *, 32> ExpVector_t;
 typedef DenseMap<const Expression *, ExprStack_t> PExprToVExprStack_t;
+typedef DenseSet<const Expression *, ProtoExpressionInfo> PExprTable_t;
+typedef SmallPtrSet<const BasicBlock *, 8> BBSet_t;
 
 /// Performs SSA PRE pass.
 class SSAPRE : public PassInfoMixin<SSAPRE> {
   const DataLayout *DL;
   const TargetLibraryInfo *TLI;
+  const TargetTransformInfo *TTI;
   AssumptionCache *AC;
   DominatorTree *DT;
+  MemorySSA *MSSA;
+  MemorySSAWalker *MSSAWalker;
+  std::unique_ptr<MemorySSAUpdater> MSSAU;
+  // Set only in the profile-guided mode and only if the function has a profile
+  BlockFrequencyInfo *BFI;
+  OptimizationRemarkEmitter *ORE;
   Function *Func;
-  ReversePostOrderTraversal<Function *> *RPOT;
+  // Set once a critical edge is split, only the CFG analyses updated along
+  // the way are preserved then
+  bool CFGChanged;
+
+  // Compile-time tiers, the bigger the function the less SSAPRE does on it,
+  // see SelectTier
+  enum Tier { T_Full, T_Reduced, T_Minimal };
+  Tier CurrentTier;
+  // Classes left out of the Factor insertion in the minimal tier
+  SmallPtrSet<const Expression *, 32> ColdPExprs;
+
+  // Value numbering mode: an instruction congruent to a dominating one, or
+  // simplified to a constant or a variable, is represented by it in the
+  // operands of the expressions, see AssignLeader
+  DenseMap<const Value *, Value *> Leaders;
+  // Occurrences of a class that have no leader and lead the rest
+  DenseMap<const Expression *, SmallVector<Instruction *, 2>> PExprToRoots;
+  // Blocks in RPO, the storage is kept between the runs
+  SmallVector<BasicBlock *, 32> RPOBlocks;
 
   BumpPtrAllocator ExpressionAllocator;
+  // Number of slabs the allocator kept after the last reset
+  size_t RetainedSlabs = 0;
+
+  // Top and Bottom sentinels of the current run, allocated in Init
+  Expression *TopExpr = nullptr;
+  Expression *BottomExpr = nullptr;
+
+  // Counters of the current run, added to the global statistics once it is
+  // over so that concurrent runs do not update shared counters on hot paths
+  struct RunStatistics {
+    unsigned InstrSubstituted = 0;
+    unsigned InstrInserted = 0;
+    unsigned InstrKilled = 0;
+    unsigned PHIInserted = 0;
+    unsigned PHIKilled = 0;
+    unsigned Factors = 0;
+    unsigned PropagationSteps = 0;
+    unsigned StoresSunk = 0;
+    unsigned AugmentingPaths = 0;
+    unsigned StrengthReduced = 0;
+    unsigned EdgesSplit = 0;
+  } Stats;
+
+  // Set if StoreSinking, StrengthReduction or CodeMotion changed the function
+  bool IRChanged;
+
+  // Held while touching the LLVMContext from the concurrent part of the pass,
+  // set only by the parallel driver
+  std::mutex *ContextLock = nullptr;
+
+  // Phases are timed with -time-passes, only if the run is not concurrent with
+  // the others since the timers are shared
+  bool TimePhases;
 
   ExpVersion_t LastVariableVersion;
   ExpVersion_t LastConstantVersion;
@@ -636,19 +1018,36 @@ class SSAPRE : public PassInfoMixin<SSAPRE> {
   typedef DenseMap<const Value *, unsigned> InstrToOrderType;
   InstrToOrderType InstrDFS;
   InstrToOrderType InstrSDFS;
+  // The first DFS number past the dominator subtree of a block, together with
+  // InstrDFS this makes every dominance query an interval check
+  DenseMap<const BasicBlock *, unsigned> DomSubtreeEnd;
 
   // Instruction-to-Expression map
   DenseMap<const Instruction *, Expression *> InstToVExpr;
   DenseMap<const Expression *, Instruction *> VExprToInst;
 
-  // ProtoExpression-to-Instructions map
-  DenseMap<const Expression *, SmallPtrSet<const Instruction *, 5>> PExprToInsts;
+  // Aggregate-to-Leader map, the leader is a dominating aggregate of the same
+  // class which the extracts of the aggregate read instead
+  DenseMap<const Value *, Instruction *> AggregateToLeader;
+
+  // ProtoExpression-to-Instructions map, the classes are kept in the order
+  // they are created so that Factors are inserted in a stable order
+  MapVector<const Expression *, SmallPtrSet<const Instruction *, 5>>
+      PExprToInsts;
 
   // ProtoExpression-to-VersionedExpressions
   DenseMap<const Expression *, SmallPtrSet<Expression *, 5>> PExprToVExprs;
 
   DenseMap<const Expression *, DenseMap<int,ExpVector_t>> PExprToVersions;
 
+  // Use-position index for the real-use queries of the renaming walk. For
+  // every expression version and every materialized Factor PHI it keeps the
+  // smallest DFS number of a (non-factored-PHI) user in each block, so the
+  // "used on the Path before E" question costs one lookup per Path block.
+  typedef DenseMap<const BasicBlock *, unsigned> UsePositions_t;
+  DenseMap<std::pair<const Expression *, int>, UsePositions_t> VersionUses;
+  DenseMap<const Instruction *, UsePositions_t> PHIUses;
+
   // ProtoExpression-to-BasicBlock map
   DenseMap<const Expression *, SmallPtrSet<BasicBlock *, 5>> PExprToBlocks;
 
@@ -656,25 +1055,74 @@ class SSAPRE : public PassInfoMixin<SSAPRE> {
   DenseMap<const BasicBlock *, SmallVector<FactorExpression *, 5>> BlockToFactors;
   DenseMap<const FactorExpression *, const BasicBlock *> FactorToBlock;
 
+  // BasicBlock-to-Predecessors map, shared by all Factors of a block
+  DenseMap<const BasicBlock *, FactorPredecessors *> BlockToPreds;
+
+  // BasicBlock-to-MemoryAccess map, the memory state at the end of a block
+  DenseMap<const BasicBlock *, MemoryAccess *> BlockToMemoryAccess;
+
+  // Register pressure estimate, the number of values live into a block for
+  // each register class. Empty unless the pressure model is enabled.
+  enum RegisterClass : unsigned { RC_Scalar, RC_Vector, RC_Num };
+  DenseMap<const BasicBlock *, std::array<unsigned, RC_Num>> BlockPressure;
+  unsigned RegisterLimit[RC_Num];
+
+  // Blocks the value is live into, kept only for the values whose live ranges
+  // were extended
+  DenseMap<const Value *, BBSet_t> ValueToLiveIn;
+
   // VersionedExpression-to-ProtoVersioned
   DenseMap<const Expression *, const Expression *> ExprToPExpr;
 
+  // Hash-consing table of the Prototype Expressions, every structurally equal
+  // expression maps to the same Prototype
+  PExprTable_t PExprTable;
+
+  // PHIs that materialized a Factor, their values are already versioned as
+  // expressions and they are not phi-translated
+  SmallPtrSet<const PHINode *, 8> FactoredPHIs;
+
+  // Factor and predecessor to the phi-translated Prototype, see FactorInsertion
+  DenseMap<std::pair<const FactorExpression *, const BasicBlock *>,
+           const Expression *> PHITranslations;
+
   SmallPtrSet<FactorExpression *, 32> FExprs;
 
+  // Factor-to-Uses map, each use is a Factor and the index of the operand
+  DenseMap<const FactorExpression *, FactorUseVector_t> FactorUses;
+
   typedef DenseMap<Expression *, Expression *> ExpExpMap;
-  DenseMap<const Expression *, ExpExpMap> Substitutions;
+
+  // Substitutions of a class form a union-find forest. Parent holds the
+  // direct substitution of an Expression(a root maps to itself), Root
+  // compresses the lookup paths. A compressed link is valid only within the
+  // epoch it was made in, relinking or removing an Expression that is not a
+  // root starts a new epoch.
+  struct SubstitutionForest {
+    ExpExpMap Parent;
+    DenseMap<Expression *, std::pair<Expression *, unsigned>> Root;
+  };
+  DenseMap<const Expression *, SubstitutionForest> Substitutions;
+  unsigned SubstitutionEpoch = 0;
 
   // Store all the PHIs that are considered to be Factors at any point in the
   // pass. Useful during kill time to separate ordinal and factored phis, since
   // former do save their operands, but later do not.
   SmallVector<Instruction *, 32> KillList;
 
+  // Membership set of the KillList, every instruction is added only once
+  SmallPtrSet<const Instruction *, 32> KillSet;
+
 public:
   PreservedAnalyses run(Function &F, AnalysisManager<Function> &AM);
 
 private:
   friend ssapre::SSAPRELegacy;
   friend ssapre::phi_factoring::TokenPropagationSolver;
+  friend class SSAPREParallelPass;
+
+  Expression *GetTop() const { return TopExpr; }
+  Expression *GetBottom() const { return BottomExpr; }
 
   // Return a reference to the vector containing all Expressions that share
   // the same version with F, by definition those occur after the F
@@ -701,11 +1149,21 @@ private:
   // Same as above but restricted to a particular Factor
   bool IsInductionExpression(const Expression *E);
 
+  // Strength reduction of the induction expressions the pass cannot move. An
+  // additive induction i = phi(i0, i + s) injures every i * c with invariant
+  // c, the injury is repaired by an additive update c * s of a new PHI at the
+  // cycle header which replaces i * c.
+  bool IsCycleInvariant(const Value *V, const BasicBlock *H);
+  Value *GetInductionStep(PHINode *PHI, Value *V);
+  bool StrengthReduction();
+
   // Returns instruction do be used with Dominance comparisons. For Factors and
   // PHIs returns the front of the containing basic block, this ensures that
   // those two treated as occurring at the same time which enables non-strict
   // dominance calculation.
   const Instruction *GetDomRepresentativeInstruction(const Expression * E);
+  // DominatorTree::dominates on DFS numbers
+  bool Dominates(const Instruction *Def, const Instruction *Use);
   // Not Strictly implies Def == Use -> False
   bool StrictlyDominates(const Expression *Def, const Expression *Use);
   // Not Strictly implies Def == Use -> True
@@ -718,6 +1176,54 @@ private:
   bool OperandsDominateStrictly(const Expression *E, const Expression *F);
   bool OperandsDominateStrictly(const Instruction *I, const Expression *F);
 
+  // Return the memory state at the start and at the end of a block, these are
+  // either the block's own MemoryPhi/MemoryDef or the state inherited from its
+  // immediate dominator
+  MemoryAccess *GetMemoryAccessAtStart(const BasicBlock *B);
+  MemoryAccess *GetMemoryAccessAtEnd(const BasicBlock *B);
+
+  // Check whether the memory access occurs before the Expression(or Factor)
+  // on every path to it, i.e. the memory did not change since
+  bool MemoryDominates(const MemoryAccess *MA, const Expression *E);
+
+  // Check whether the Expression class reads memory, such classes are
+  // versioned by MemorySSA as well
+  bool ReadsMemory(const Expression *PE);
+
+  // Check whether V is a PHI of the block B that a Factor there phi-translates
+  bool IsTranslatedPHI(const Value *V, const BasicBlock *B);
+
+  // Check whether some operands of the Expression class are PHIs of the block
+  // B, a Factor there phi-translates these operands
+  bool HasPHIOperandsAt(const Expression *PE, const BasicBlock *B);
+
+  // Find the Prototype of the Factor's Expression with its PHI operands
+  // translated into the values incoming from the predecessor P, null if there
+  // is no such Expression in the function
+  const Expression *GetPHITranslated(const FactorExpression *F,
+                                     const BasicBlock *P);
+
+  // Check whether E reads the same memory as the top of its stack T, for an
+  // Expression that does not read memory this is trivially true
+  bool MemoryDominates(const Expression *E, const Expression *T);
+
+  // Same as above but for the memory state at the end of the block B
+  bool MemoryAvailableAtEnd(const BasicBlock *B, const Expression *T);
+
+  // Check whether the Expression can be inserted for the operand of F coming
+  // from B, at the end of B or on the edge if it is split. A load or a call
+  // may only be placed there if it does not introduce a fault on some path
+  bool IsSafeToInsert(const Expression *PE, const FactorExpression *F,
+                      BasicBlock *B);
+
+  // Record the first use position of every user of I in its block
+  void AddUsePositions(UsePositions_t &UP, const Instruction *I);
+
+  // Find out whether any of the recorded uses is on a Path before(including)
+  // the DFS number EDFS
+  bool HasUseOnPathBefore(const UsePositions_t &UP, const BBVector_t &P,
+                          unsigned EDFS);
+
   // Find out whether Expression versions are used on a Path before(including)
   // another Expression occurrence
   bool HasRealUseBefore(const Expression *S, const BBVector_t &P,
@@ -733,7 +1239,27 @@ private:
   bool IsToBeKilled(Instruction *I);
   bool AllUsersKilled(const Instruction *I);
 
+  // Add the instruction to the KillList unless it is already there, returns
+  // true if it was added
+  bool AddToKillList(Instruction *I);
+
   void SetOrderBefore(Instruction *I, Instruction *B);
+  Instruction *CloneProto(const Expression *PE);
+
+  // Check whether the edge from P to the Factor F is critical and can be
+  // split, so that an operand coming from P is inserted on the edge itself
+  bool IsEdgeSplit(const FactorExpression *F, const BasicBlock *P);
+
+  // Return the block to insert an operand of the Factor F coming from P at
+  // the end of. If IsEdgeSplit the edge is split and the new block is
+  // returned, otherwise this is P itself.
+  BasicBlock *GetInsertionBlock(FactorExpression *F, BasicBlock *P);
+
+  // Same as above but the PHIs of B among the operands are replaced with their
+  // values incoming from P
+  Instruction *CloneProto(const Expression *PE, const BasicBlock *B,
+                          const BasicBlock *P);
+  void InsertMemoryAccess(Instruction *I, MemorySSA::InsertionPlace P);
   void SetAllOperandsSave(Instruction *I);
   void AddSubstitution(Expression *E, Expression *S,
                        bool Direct = false, bool Force = false);
@@ -780,6 +1306,8 @@ private:
   bool ShouldSwapOperands(const Value *A, const Value *B) const;
 
   bool FillInBasicExpressionInfo(Instruction &I, BasicExpression *E);
+  Value *GetLeader(Value *V);
+  void AssignLeader(Instruction &I, const Expression *PE, Expression *VE);
 
   std::pair<unsigned, unsigned>
   AssignDFSNumbers(BasicBlock *B, unsigned Start, InstrToOrderType *M);
@@ -795,13 +1323,24 @@ private:
   Expression * CreateUnknownExpression(Instruction &I);
   Expression * CreateBasicExpression(Instruction &I);
   Expression * CreatePHIExpression(PHINode &I);
+  Expression * CreateAggregateValueExpression(Instruction &I);
+  Expression * CreateLoadExpression(LoadInst &I);
+  Expression * CreateCallExpression(CallInst &I);
 
+  const FactorPredecessors &GetFactorPredecessors(const BasicBlock &B);
   FactorExpression *
   CreateFactorExpression(const Expression &E, const BasicBlock &B);
 
   Expression * CreateExpression(Instruction &I);
 
+  // Stores to the same address that end every predecessor of a join are
+  // replaced with a single store at the start of the join
+  bool IsSinkableStore(const StoreInst *S, const StoreInst *First,
+                       const BasicBlock *B);
+  bool StoreSinking();
+
   void Init(Function &F);
+  void SelectTier(Function &F);
   void Fini();
 
   void FactorInsertionMaterialized();
@@ -813,15 +1352,56 @@ private:
   void RenameInductivityPass();
   void Rename();
 
-  void ResetDownSafety(FactorExpression *F, Expression *E);
+  // Build Factor-operand def-use graph used by the propagation steps
+  void BuildFactorGraph();
+
+  // Check whether a Factor at a loop header may be treated as DownSafe even
+  // though its expression is not anticipated on every path
+  bool IsSpeculationCandidate(const FactorExpression *F);
+
   void DownSafety();
 
   void ComputeCanBeAvail();
-  void ResetCanBeAvail(FactorExpression *F);
+  // Propagate the loss of CanBeAvail from the Factors in Worklist to the
+  // Factors that use them
+  void ResetCanBeAvail(FEVector_t &Worklist);
   void ComputeLater();
-  void ResetLater(FactorExpression *F);
+
+  // Profile-guided placement, the WillBeAvail flags of non-cycled Factors are
+  // recomputed as a minimum cut of each expression's Factor graph weighted by
+  // block frequencies. This may make a Factor that is not DownSafe available
+  // if speculative insertions into its predecessors are safe and cheaper than
+  // the computations they replace.
+  uint64_t GetFrequency(const BasicBlock *B);
+  void ComputeMinCut();
+
+  // Check whether hoisting a cycled Factor's computation into the non-cycled
+  // predecessor PB executes it less often than it is executed now
+  bool IsProfitableCycleHoist(FactorExpression *F, const BasicBlock *PB);
+
   void WillBeAvail();
 
+  // Register pressure model, live values are counted per block and register
+  // class with the limits taken from TargetTransformInfo
+  RegisterClass GetRegisterClass(Type *T) const;
+  void ComputeLiveIn(const Value *V, const BasicBlock *DefB, BBSet_t &LiveIn);
+  void ComputeRegisterPressure();
+
+  // Make the available Factors whose PHIs would not fit into registers not
+  // available in any way, in dominator tree order
+  void ComputePressureAvail();
+
+  // Return the blocks the value of I is live into, computed on first request
+  BBSet_t &GetLiveIn(const Instruction *I);
+
+  // Extend the live range of a value of type T defined in DefB to the blocks
+  // UseBs, LiveIn is the set of blocks it is already live into. Nothing
+  // changes and a missed remark at R is emitted if some block would exceed
+  // the register limit, otherwise a passed one is.
+  bool ExtendLiveRange(Type *T, const BasicBlock *DefB,
+                       ArrayRef<const BasicBlock *> UseBs, BBSet_t &LiveIn,
+                       const Instruction *R);
+
   void Finalize();
 
   bool FactorCleanup(FactorExpression * F);
@@ -852,9 +1432,27 @@ private:
   void PrintDebugKillist();
   void PrintDebug(const std::string &Caption, PrintInfo PI = PI_Default);
 
+  // The three parts of runImpl. Prepare and Apply change the IR and the
+  // LLVMContext, Analyze works on the pass' own state only and runs of
+  // different functions may do it concurrently.
+  void Prepare(Function &F, AssumptionCache &_AC, TargetLibraryInfo &_TLI,
+               TargetTransformInfo &_TTI, DominatorTree &_DT, MemorySSA &_MSSA,
+               BlockFrequencyInfo *_BFI, OptimizationRemarkEmitter &_ORE);
+  void Analyze();
+  PreservedAnalyses Apply();
+
   PreservedAnalyses
   runImpl(Function &F, AssumptionCache &_AC, TargetLibraryInfo &_TLI,
-          DominatorTree &_DT);
+          TargetTransformInfo &_TTI, DominatorTree &_DT, MemorySSA &_MSSA,
+          BlockFrequencyInfo *_BFI, OptimizationRemarkEmitter &_ORE);
+};
+
+/// Runs SSAPRE on every function of a module, the analysis part of the
+/// functions runs concurrently on a ThreadPool. The IR is changed in module
+/// order, so the result is the same for any number of threads.
+class SSAPREParallelPass : public PassInfoMixin<SSAPREParallelPass> {
+public:
+  PreservedAnalyses run(Module &M, ModuleAnalysisManager &AM);
 };
 } // end namespace llvm
 
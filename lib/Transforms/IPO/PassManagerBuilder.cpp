@@ -74,6 +74,11 @@ static cl::opt<bool> RunLoadCombine("combine-loads", cl::init(false),
 static cl::opt<bool> RunNewGVN("enable-newgvn", cl::init(false), cl::Hidden,
                                cl::desc("Run the NewGVN pass"));
 
+// Shared with the PassBuilder, both pipelines schedule SSAPRE at the same point
+cl::opt<bool> RunSSAPRE("enable-ssapre", cl::init(false), cl::Hidden,
+                        cl::desc("Run GVN without PRE followed by the SSAPRE "
+                                 "pass"));
+
 static cl::opt<bool>
 RunSLPAfterLoopVectorization("run-slp-after-loop-vectorization",
   cl::init(true), cl::Hidden,
@@ -158,6 +163,7 @@ PassManagerBuilder::PassManagerBuilder() {
     RerollLoops = RunLoopRerolling;
     LoadCombine = RunLoadCombine;
     NewGVN = RunNewGVN;
+    SSAPRE = RunSSAPRE;
     DisableGVNLoadPRE = false;
     VerifyInput = false;
     VerifyOutput = false;
@@ -325,8 +331,13 @@ void PassManagerBuilder::addFunctionSimplificationPasses(
 
   if (OptLevel > 1) {
     MPM.add(createMergedLoadStoreMotionPass()); // Merge ld/st in diamonds
-    MPM.add(NewGVN ? createNewGVNPass()
-                   : createGVNPass(DisableGVNLoadPRE)); // Remove redundancies
+    if (NewGVN)
+      MPM.add(createNewGVNPass());
+    else if (SSAPRE) {
+      MPM.add(createGVNPass(DisableGVNLoadPRE, /*NoPRE=*/true));
+      MPM.add(createSSAPREPass());               // Partial redundancies
+    } else
+      MPM.add(createGVNPass(DisableGVNLoadPRE)); // Remove redundancies
   }
   MPM.add(createMemCpyOptPass());             // Remove memcpy / form memset
   MPM.add(createSCCPPass());                  // Constant prop with SCCP
@@ -15,11 +15,17 @@
 
 #include "llvm/Transforms/Scalar/SSAPRE.h"
 #include "llvm/Transforms/Scalar.h"
-#include "llvm/Transforms/Utils/BreakCriticalEdges.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/GlobalsModRef.h"
 #include "llvm/Analysis/IteratedDominanceFrontier.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/Analysis/Loads.h"
+#include "llvm/Analysis/MemoryLocation.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -28,6 +34,7 @@
 #include "llvm/IR/PatternMatch.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/Pass.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
@@ -35,7 +42,9 @@
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SCCIterator.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SparseBitVector.h"
@@ -43,8 +52,13 @@
 #include "llvm/ADT/TinyPtrVector.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <thread>
 
 using namespace llvm;
 using namespace llvm::ssapre;
@@ -56,7 +70,82 @@ STATISTIC(SSAPREInstrInserted,     "Number of instructions inserted");
 STATISTIC(SSAPREInstrKilled,       "Number of instructions deleted");
 STATISTIC(SSAPREPHIInserted,       "Number of phi inserted");
 STATISTIC(SSAPREPHIKilled,         "Number of phi deleted");
-STATISTIC(SSAPREBlah,              "Blah");
+STATISTIC(SSAPREFactors,           "Number of Factors");
+STATISTIC(SSAPREAllocatorBytes,    "Peak bytes in the expression allocator");
+STATISTIC(SSAPRESlabsAllocated,    "Number of expression slabs allocated");
+STATISTIC(SSAPREPropagationSteps,  "Number of Factor graph propagation steps");
+STATISTIC(SSAPREStoresSunk,        "Number of stores sunk");
+STATISTIC(SSAPREAugmentingPaths,   "Number of min-cut augmenting paths");
+STATISTIC(SSAPREStrengthReduced,   "Number of induction expressions reduced");
+STATISTIC(SSAPREEdgesSplit,        "Number of critical edges split");
+
+static const char *const SSAPRETimerGroup = "ssapre";
+static const char *const SSAPRETimerGroupDesc = "SSAPRE Phases";
+
+static cl::opt<bool> SSAPREProfileGuided(
+    "ssapre-profile-guided", cl::init(false), cl::Hidden,
+    cl::desc("Place computations by a frequency-weighted minimum cut of the "
+             "Factor graph when a profile is available"));
+
+static cl::opt<bool> SSAPRERegisterPressure(
+    "ssapre-register-pressure", cl::init(false), cl::Hidden,
+    cl::desc("Do not eliminate redundancies that would make the number of "
+             "live values exceed the number of registers"));
+
+static cl::opt<unsigned> SSAPREThreads(
+    "ssapre-threads", cl::Hidden, cl::init(0),
+    cl::desc("Number of threads of the module SSAPRE driver, zero means one "
+             "per hardware thread"));
+
+static cl::opt<unsigned> SSAPREBatchSize(
+    "ssapre-batch-size", cl::Hidden, cl::init(256),
+    cl::desc("Number of functions the module SSAPRE driver analyzes at once"));
+
+static cl::opt<unsigned> SSAPRETierReducedSize(
+    "ssapre-tier-reduced-size", cl::Hidden, cl::init(20000),
+    cl::desc("Number of instructions above which SSAPRE does not factor "
+             "existing PHIs and does not speculate"));
+
+static cl::opt<unsigned> SSAPRETierReducedClasses(
+    "ssapre-tier-reduced-classes", cl::Hidden, cl::init(5000),
+    cl::desc("Number of expression classes above which SSAPRE does not "
+             "factor existing PHIs and does not speculate"));
+
+static cl::opt<unsigned> SSAPRETierMinimalSize(
+    "ssapre-tier-minimal-size", cl::Hidden, cl::init(100000),
+    cl::desc("Number of instructions above which SSAPRE also ignores cycles "
+             "and places Factors for the hottest classes only"));
+
+static cl::opt<unsigned> SSAPRETierMinimalClasses(
+    "ssapre-tier-minimal-classes", cl::Hidden, cl::init(20000),
+    cl::desc("Number of expression classes above which SSAPRE also ignores "
+             "cycles and places Factors for the hottest classes only"));
+
+static cl::opt<unsigned> SSAPRETierHotClasses(
+    "ssapre-tier-hot-classes", cl::Hidden, cl::init(2000),
+    cl::desc("Number of the hottest expression classes that get Factors in "
+             "the minimal tier"));
+
+static cl::opt<bool> SSAPREValueNumbering(
+    "ssapre-value-numbering", cl::init(false), cl::Hidden,
+    cl::desc("Build expression classes from value-numbered operands instead "
+             "of lexically equal ones"));
+
+static cl::opt<bool> SSAPREStrengthReduction(
+    "ssapre-strength-reduction", cl::init(false), cl::Hidden,
+    cl::desc("Replace multiplications of additive induction variables with "
+             "additive updates carried through the cycle header"));
+
+static cl::opt<bool> SSAPRESpeculate(
+    "ssapre-speculate", cl::init(false), cl::Hidden,
+    cl::desc("Hoist cheap non-faulting computations out of cycles even if "
+             "they are executed conditionally"));
+
+static cl::opt<unsigned> SSAPRESpeculationThreshold(
+    "ssapre-speculation-threshold", cl::init(TargetTransformInfo::TCC_Basic),
+    cl::Hidden,
+    cl::desc("The highest cost of a computation that is speculated at a "
+             "cycle header"));
 
 // Anchor methods.
 namespace llvm {
@@ -66,6 +155,10 @@ IgnoredExpression::~IgnoredExpression() = default;
 UnknownExpression::~UnknownExpression() = default;
 BasicExpression::~BasicExpression() = default;
 PHIExpression::~PHIExpression() = default;
+AggregateValueExpression::~AggregateValueExpression() = default;
+MemoryExpression::~MemoryExpression() = default;
+LoadExpression::~LoadExpression() = default;
+CallExpression::~CallExpression() = default;
 FactorExpression::~FactorExpression() = default;
 }
 }
@@ -79,11 +172,6 @@ IsVersionUnset(const Expression *E) {
   return E->getVersion() == VR_Unset;
 }
 
-static Expression TExpr(ET_Top,    ~2U, VR_Top);
-static Expression BExpr(ET_Bottom, ~2U, VR_Bottom);
-static Expression * GetTop()    { return &TExpr; }
-static Expression * GetBottom() { return &BExpr; }
-
 bool SSAPRE::
 IsTop(const Expression *E) {
   assert(E);
@@ -160,6 +248,31 @@ GetDomRepresentativeInstruction(const Expression * E) {
   return VExprToInst[E];
 }
 
+bool SSAPRE::
+Dominates(const Instruction *Def, const Instruction *Use) {
+  // Unreachable and split off blocks have no numbers, an invoke defines its
+  // value on an edge, and instructions inserted at the same point share
+  // their number; the dominator tree sorts those out
+  auto DI = InstrDFS.find(Def);
+  auto UI = InstrDFS.find(Use);
+  auto DE = DomSubtreeEnd.find(Def->getParent());
+  if (DI == InstrDFS.end() || UI == InstrDFS.end() ||
+      DE == DomSubtreeEnd.end() || DI->second == UI->second ||
+      isa<InvokeInst>(Def))
+    return DT->dominates(Def, Use);
+
+  // Blocks are numbered in DFS order of the dominator tree, the instructions
+  // of a block are in order, so Def dominates everything after it up to the
+  // end of its block's subtree. A PHI uses its operands at the end of the
+  // predecessors, an instruction of its own block does not dominate it.
+  auto D = DI->second;
+  auto U = UI->second;
+  bool R = D < U && U < DE->second &&
+           !(isa<PHINode>(Use) && Def->getParent() == Use->getParent());
+  assert(R == DT->dominates(Def, Use) && "DFS numbers are out of date");
+  return R;
+}
+
 bool SSAPRE::
 StrictlyDominates(const Expression *Def, const Expression *Use) {
   assert (Def && Use && "Def or Use is null");
@@ -172,7 +285,7 @@ StrictlyDominates(const Expression *Def, const Expression *Use) {
   // Strictly
   if (IDef == IUse) return false;
 
-  return DT->dominates(IDef, IUse);
+  return Dominates(IDef, IUse);
 }
 
 bool SSAPRE::
@@ -187,7 +300,7 @@ NotStrictlyDominates(const Expression *Def, const Expression *Use) {
   // Not Strictly
   if (IDef == IUse) return true;
 
-  return DT->dominates(IDef, IUse);
+  return Dominates(IDef, IUse);
 }
 
 bool SSAPRE::
@@ -197,7 +310,14 @@ OperandsDominate(const Expression *Def, const Expression *Use) {
 
 bool SSAPRE::
 OperandsDominate(const Instruction *I, const Expression *Use) {
+  // A PHI of the Factor's block is phi-translated into the Factor's operands,
+  // in this regard it defines the operand at the Factor
+  auto UF = dyn_cast<FactorExpression>(Use);
+  auto UB = UF && !UF->getIsMaterialized() ? FactorToBlock[UF] : nullptr;
+
   for (auto &O : I->operands()) {
+    if (UB && IsTranslatedPHI(O, UB)) continue;
+
     auto E = ValueToExp[O];
 
     // Variables or Constants occurs indefinitely before any expression
@@ -205,8 +325,10 @@ OperandsDominate(const Instruction *I, const Expression *Use) {
 
     // We want to use the earliest occurrence of the operand, it will be either
     // a Factor, another definition or the same definition if it defines a new
-    // version.
-    E = GetSubstitution(E);
+    // version. A killed Factor leaves a top or a bottom behind, the operand
+    // then stays where it is defined.
+    auto SE = GetSubstitution(E);
+    if (!IsTop(SE) && !IsBottom(SE)) E = SE;
 
     if (IsVariableOrConstant(E)) continue;
 
@@ -233,8 +355,10 @@ OperandsDominateStrictly(const Instruction *I, const Expression *Use) {
 
     // We want to use the earliest occurrence of the operand, it will be either
     // a Factor, another definition or the same definition if it defines a new
-    // version.
-    E = GetSubstitution(E);
+    // version. A killed Factor leaves a top or a bottom behind, the operand
+    // then stays where it is defined.
+    auto SE = GetSubstitution(E);
+    if (!IsTop(SE) && !IsBottom(SE)) E = SE;
 
     if (IsVariableOrConstant(E)) continue;
 
@@ -244,31 +368,220 @@ OperandsDominateStrictly(const Instruction *I, const Expression *Use) {
   return true;
 }
 
+MemoryAccess * SSAPRE::
+GetMemoryAccessAtStart(const BasicBlock *B) {
+  if (auto MP = MSSA->getMemoryAccess(B)) return MP;
+
+  // Without a MemoryPhi every path to B carries the same memory state, the one
+  // its immediate dominator ends with
+  auto N = DT->getNode((BasicBlock *)B)->getIDom();
+  if (!N) return MSSA->getLiveOnEntryDef();
+  return GetMemoryAccessAtEnd(N->getBlock());
+}
+
+MemoryAccess * SSAPRE::
+GetMemoryAccessAtEnd(const BasicBlock *B) {
+  auto It = BlockToMemoryAccess.find(B);
+  if (It != BlockToMemoryAccess.end()) return It->second;
+
+  MemoryAccess *MA = nullptr;
+  if (auto Defs = MSSA->getBlockDefs(B))
+    MA = (MemoryAccess *)&*Defs->rbegin();
+  else
+    MA = GetMemoryAccessAtStart(B);
+
+  BlockToMemoryAccess[B] = MA;
+  return MA;
+}
+
 bool SSAPRE::
-HasRealUseBefore(const Expression *S, const BBVector_t &P,
-                 const Expression *E) {
-  auto EDFS = InstrDFS[VExprToInst[E]];
+MemoryDominates(const MemoryAccess *MA, const Expression *E) {
+  assert(MA && E);
+  if (MSSA->isLiveOnEntryDef(MA)) return true;
 
-  // We need to check every expression that shares the same version
-  for (auto V : GetSameVExpr(S)) {
-    for (auto U : VExprToInst[V]->users()) {
-      auto UI = (Instruction *)U;
+  auto MB = MA->getBlock();
+
+  // Factors occur at the very beginning of their blocks, only a MemoryPhi of
+  // the same block goes before them
+  if (auto F = dyn_cast<FactorExpression>(E)) {
+    auto B = FactorToBlock[F];
+    if (MB == B) return isa<MemoryPhi>(MA);
+    return DT->dominates(MB, B);
+  }
 
-      // Ignore PHIs that are linked with Factors, since those bonds solved
-      // through the main algorithm
-      if (IsFactoredPHI(UI)) continue;
+  auto I = VExprToInst[E];
+  auto B = I->getParent();
+  if (MB != B) return DT->dominates(MB, B);
+  if (isa<MemoryPhi>(MA)) return true;
+  return MSSA->locallyDominates(MA, MSSA->getMemoryAccess(I));
+}
 
-      auto UB = UI->getParent();
-      for (auto PB : P) {
-        // User is on the Path and it happens before E
-        if (UB == PB && InstrDFS[UI] <= EDFS) return true;
-      }
+bool SSAPRE::
+ReadsMemory(const Expression *PE) {
+  assert(PE);
+  return MemoryExpression::classof(PE) && PE->getProto()->mayReadFromMemory();
+}
+
+bool SSAPRE::
+IsTranslatedPHI(const Value *V, const BasicBlock *B) {
+  auto PHI = dyn_cast<PHINode>(V);
+  return PHI && PHI->getParent() == B && !FactoredPHIs.count(PHI);
+}
+
+bool SSAPRE::
+HasPHIOperandsAt(const Expression *PE, const BasicBlock *B) {
+  assert(PE && B);
+  // The memory operand is versioned through MemoryPhis instead
+  if (!BasicExpression::classof(PE) || PHIExpression::classof(PE) ||
+      MemoryExpression::classof(PE) || !PE->getProto())
+    return false;
+
+  for (auto &O : PE->getProto()->operands()) {
+    if (IsTranslatedPHI(O, B)) return true;
+  }
+
+  return false;
+}
+
+const Expression * SSAPRE::
+GetPHITranslated(const FactorExpression *F, const BasicBlock *P) {
+  assert(F && P);
+  auto PE = F->getPExpr();
+  auto B = FactorToBlock[F];
+
+  // The translated Expression is never inserted, we only need its Prototype,
+  // so instead of an instruction we translate the operands of a new Expression
+  auto TE = dyn_cast<BasicExpression>(CreateExpression(*PE->getProto()));
+  if (!TE) return nullptr;
+  for (unsigned i = 0, l = TE->getNumOperands(); i < l; ++i) {
+    auto O = TE->getOperand(i);
+    if (IsTranslatedPHI(O, B))
+      TE->setOperand(
+          i, GetLeader(cast<PHINode>(O)->getIncomingValueForBlock(P)));
+  }
+
+  // Restore the canonical order of the operands, see CreateBasicExpression
+  auto I = PE->getProto();
+  if ((I->isCommutative() || isa<CmpInst>(I)) &&
+      ShouldSwapOperands(TE->getOperand(0), TE->getOperand(1))) {
+    TE->swapOperands(0, 1);
+    if (isa<CmpInst>(I)) {
+      auto Predicate = (CmpInst::Predicate)(TE->getOpcode() & 0xff);
+      TE->setOpcode((TE->getOpcode() & ~0xffU) |
+                    CmpInst::getSwappedPredicate(Predicate));
     }
   }
 
+  auto TEI = PExprTable.find(TE);
+  const Expression *TPE = TEI != PExprTable.end() ? *TEI : nullptr;
+  ExpressionAllocator.Deallocate(TE);
+
+  if (TPE && (TPE == PE || IgnoreExpression(TPE) || !TPE->getProto()))
+    return nullptr;
+
+  return TPE;
+}
+
+bool SSAPRE::
+MemoryDominates(const Expression *E, const Expression *T) {
+  auto ME = dyn_cast<MemoryExpression>(E);
+  if (!ME || !ME->getClobberingAccess()) return true;
+  return MemoryDominates(ME->getClobberingAccess(), T);
+}
+
+bool SSAPRE::
+MemoryAvailableAtEnd(const BasicBlock *B, const Expression *T) {
+  auto PE = ExprToPExpr[T];
+  if (!ReadsMemory(PE)) return true;
+
+  auto MA = GetMemoryAccessAtEnd(B);
+
+  // We do not use the Proto's AA metadata here, it belongs to a particular
+  // occurrence and not to the whole class
+  if (auto LI = dyn_cast<LoadInst>(PE->getProto())) {
+    MemoryLocation Loc(LI->getPointerOperand(),
+                       DL->getTypeStoreSize(LI->getType()));
+    MA = MSSAWalker->getClobberingMemoryAccess(MA, Loc);
+  }
+
+  // A call is not disambiguated any further, any memory change since T makes
+  // it unavailable
+  return MemoryDominates(MA, T);
+}
+
+bool SSAPRE::
+IsSafeToInsert(const Expression *PE, const FactorExpression *F,
+               BasicBlock *B) {
+  auto I = PE->getProto();
+  auto T = B->getTerminator();
+
+  // A speculative Factor is DownSafe only by assumption
+  bool Anticipated = F->getDownSafe() && !F->getSpeculative();
+  if (!MemoryExpression::classof(PE))
+    return Anticipated || isSafeToSpeculativelyExecute(I);
+
+  // A critical edge is split, the insertion goes to a new block that leads
+  // only to the Factor and ends with a plain branch
+  bool Split = IsEdgeSplit(F, B);
+
+  // The new access goes to the end of the block, so the terminator must not
+  // access memory itself
+  if (!Split && I->mayReadFromMemory() && MSSA->getMemoryAccess(T))
+    return false;
+
+  // The value is anticipated at the Factor and the block leads nowhere else
+  if (Anticipated && (Split || B->getSingleSuccessor())) return true;
+
+  if (auto LI = dyn_cast<LoadInst>(I))
+    return isSafeToLoadUnconditionally(LI->getPointerOperand(),
+                                       LI->getAlignment(), *DL, T, DT);
+
+  return isSafeToSpeculativelyExecute(I);
+}
+
+void SSAPRE::
+AddUsePositions(UsePositions_t &UP, const Instruction *I) {
+  for (auto U : I->users()) {
+    auto UI = (Instruction *)U;
+
+    // Ignore PHIs that are linked with Factors, since those bonds solved
+    // through the main algorithm
+    if (IsFactoredPHI(UI)) continue;
+
+    auto UDFS = InstrDFS.lookup(UI);
+    auto It = UP.find(UI->getParent());
+    if (It == UP.end())
+      UP.insert({UI->getParent(), UDFS});
+    else
+      It->second = std::min(It->second, UDFS);
+  }
+}
+
+bool SSAPRE::
+HasUseOnPathBefore(const UsePositions_t &UP, const BBVector_t &P,
+                   unsigned EDFS) {
+  if (UP.empty()) return false;
+
+  for (auto PB : P) {
+    // User is on the Path and it happens before E
+    auto It = UP.find(PB);
+    if (It != UP.end() && It->second <= EDFS) return true;
+  }
+
   return false;
 }
 
+bool SSAPRE::
+HasRealUseBefore(const Expression *S, const BBVector_t &P,
+                 const Expression *E) {
+  auto EDFS = InstrDFS[VExprToInst[E]];
+
+  // We need to check every expression that shares the same version, their
+  // users are indexed as the versions are assigned
+  auto It = VersionUses.find({ExprToPExpr[S], S->getVersion()});
+  return It != VersionUses.end() && HasUseOnPathBefore(It->second, P, EDFS);
+}
+
 bool SSAPRE::
 FactorHasRealUseBefore(const FactorExpression *F, const BBVector_t &P,
                        const Expression *E) {
@@ -276,40 +589,18 @@ FactorHasRealUseBefore(const FactorExpression *F, const BBVector_t &P,
 
   // If Factor is linked with a PHI we need to check its users.
   if (auto PHI = FactorToPHI[F]) {
-    for (auto U : PHI->users()) {
-      auto UI = (Instruction *)U;
-
-      // Ignore PHIs that are linked with Factors, since those bonds solved
-      // through the main algorithm
-      if (IsFactoredPHI(UI)) continue;
-
-      auto UB = UI->getParent();
-      for (auto PB : P) {
-        // User is on the Path and it happens before E
-        if (UB == PB && InstrDFS[UI] <= EDFS) return true;
-      }
+    auto It = PHIUses.find(PHI);
+    if (It == PHIUses.end()) {
+      It = PHIUses.insert({PHI, UsePositions_t()}).first;
+      AddUsePositions(It->second, PHI);
     }
+    if (HasUseOnPathBefore(It->second, P, EDFS)) return true;
   }
 
   // We check every Expression of the same version as the Factor we check,
   // since by definition those will come after the Factor
-  for (auto V : GetSameVExpr(F)) {
-    for (auto U : VExprToInst[V]->users()) {
-      auto UI = (Instruction *)U;
-
-      // Ignore PHIs that are linked with Factors, since those bonds solved
-      // through the main algorithm
-      if (IsFactoredPHI(UI)) continue;
-
-      auto UB = UI->getParent();
-      for (auto PB : P) {
-        // User is on the Path and it happens before E
-        if (UB == PB && InstrDFS[UI] <= EDFS) return true;
-      }
-    }
-  }
-
-  return false;
+  auto It = VersionUses.find({F->getPExpr(), F->getVersion()});
+  return It != VersionUses.end() && HasUseOnPathBefore(It->second, P, EDFS);
 }
 
 bool SSAPRE::
@@ -327,19 +618,13 @@ IsToBeKilled(Expression *E) {
   assert(E);
   auto V = ExpToValue[E];
   assert(V);
-  for (auto K : KillList) {
-    if (V == K) return true;
-  }
-  return false;
+  return KillSet.count((const Instruction *)V);
 }
 
 bool SSAPRE::
 IsToBeKilled(Instruction *I) {
   assert(I);
-  for (auto K : KillList) {
-    if (I == K) return true;
-  }
-  return false;
+  return KillSet.count(I);
 }
 
 bool SSAPRE::
@@ -347,21 +632,19 @@ AllUsersKilled(const Instruction *I) {
   assert(I);
   for (auto U : I->users()) {
     auto UI = (Instruction *)U;
-    if (UI->getParent()) {
-      bool Killed = false;
-      for (auto K : KillList) {
-        if (K == UI) {
-          Killed = true;
-          break;
-        }
-      }
-
-      if (!Killed) return false;
-    }
+    if (UI->getParent() && !KillSet.count(UI)) return false;
   }
   return true;
 }
 
+bool SSAPRE::
+AddToKillList(Instruction *I) {
+  assert(I);
+  if (!KillSet.insert(I).second) return false;
+  KillList.push_back(I);
+  return true;
+}
+
 void SSAPRE::
 SetOrderBefore(Instruction *I, Instruction *B) {
   assert(I && B);
@@ -369,6 +652,87 @@ SetOrderBefore(Instruction *I, Instruction *B) {
   InstrDFS[I]  = InstrDFS[B];  InstrDFS[B]++;
 }
 
+Instruction * SSAPRE::
+CloneProto(const Expression *PE) {
+  assert(PE && PE->getProto());
+  auto I = PE->getProto()->clone();
+
+  // The Proto's metadata describes the value of its original occurrence, for a
+  // load it does not necessarily hold at the insertion point
+  if (isa<LoadInst>(I)) I->dropUnknownNonDebugMetadata();
+  return I;
+}
+
+bool SSAPRE::
+IsEdgeSplit(const FactorExpression *F, const BasicBlock *P) {
+  assert(F && P);
+  auto B = F->getBB();
+  auto PT = P->getTerminator();
+
+  // Several edges from P share a single operand, and neither an indirect
+  // branch nor an edge into an EH pad can be split, the end of P is the best
+  // we can do
+  if (F->GetPredMult(P) != 1 || isa<IndirectBrInst>(PT) || B->isEHPad())
+    return false;
+
+  return isCriticalEdge(PT, GetSuccessorNumber(P, B));
+}
+
+BasicBlock * SSAPRE::
+GetInsertionBlock(FactorExpression *F, BasicBlock *P) {
+  assert(F && P);
+  if (!IsEdgeSplit(F, P)) return P;
+
+  auto B = (BasicBlock *)FactorToBlock[F];
+  auto PT = P->getTerminator();
+  auto NB = SplitCriticalEdge(PT, GetSuccessorNumber(P, B),
+                              CriticalEdgeSplittingOptions(DT));
+  assert(NB && "Critical edge is not split");
+
+  Stats.EdgesSplit++;
+  CFGChanged = true;
+
+  // Every Factor of B and its MemoryPhi now see the new block as the
+  // predecessor
+  BlockToPreds[B]->replace(P, NB);
+  if (auto MP = MSSA->getMemoryAccess(B)) {
+    for (unsigned i = 0, l = MP->getNumIncomingValues(); i < l; ++i)
+      if (MP->getIncomingBlock(i) == P) MP->setIncomingBlock(i, NB);
+  }
+
+  // The new block follows P in DFS order, its terminator takes P's terminator
+  // numbers so instructions can be ordered before it
+  auto NT = NB->getTerminator();
+  InstrDFS[NT] = InstrDFS[PT];
+  InstrSDFS[NT] = InstrSDFS[PT];
+  return NB;
+}
+
+Instruction * SSAPRE::
+CloneProto(const Expression *PE, const BasicBlock *B, const BasicBlock *P) {
+  auto I = CloneProto(PE);
+  for (auto &O : I->operands()) {
+    if (IsTranslatedPHI(O, B))
+      O.set(cast<PHINode>(O)->getIncomingValueForBlock(P));
+  }
+  return I;
+}
+
+void SSAPRE::
+InsertMemoryAccess(Instruction *I, MemorySSA::InsertionPlace P) {
+  assert(I && I->getParent());
+  if (!I->mayReadFromMemory()) return;
+
+  auto B = I->getParent();
+  auto D = P == MemorySSA::End ? GetMemoryAccessAtEnd(B)
+                               : GetMemoryAccessAtStart(B);
+  auto MA = MSSAU->createMemoryAccessInBB(I, D, B, P);
+
+  // The Expression was created before the instruction had an access
+  if (auto ME = dyn_cast_or_null<MemoryExpression>(InstToVExpr[I]))
+    ME->setClobberingAccess(MSSAWalker->getClobberingMemoryAccess(MA));
+}
+
 void SSAPRE::
 SetAllOperandsSave(Instruction *I) {
   assert(I);
@@ -393,11 +757,11 @@ AddSubstitution(Expression *E, Expression *S, bool Direct, bool Force) {
 
   assert(PE);
 
-  if (!Substitutions.count(PE)) {
-    Substitutions.insert({PE, ExpExpMap()});
-  }
+  auto &MA = Substitutions[PE].Parent;
 
-  auto &MA = Substitutions[PE];
+  // Compressed paths that go through a non-root are no longer valid
+  auto Old = MA.lookup(E);
+  if (Old && Old != E && Old != S) ++SubstitutionEpoch;
 
   if (E == S) {
     MA[E] = S;
@@ -427,24 +791,35 @@ GetSubstitution(Expression *E, bool Direct) {
 
   if (IsBottomOrVarOrConst(E) || IsTop(E)) return E;
 
-  auto PE = ExprToPExpr[E];
-  if (!PE) PE = E;
-  if (!Substitutions.count(PE)) {
-    llvm_unreachable("This type of expressions does not exist in the record");
-  }
-  auto &MA = Substitutions[PE];
+  // Expressions we pass on the way to the root, they get compressed
+  SmallVector<std::pair<SubstitutionForest *, Expression *>, 8> Path;
+
+  while (!IsBottomOrVarOrConst(E) && !IsTop(E)) {
+    auto PE = ExprToPExpr[E];
+    if (!PE) PE = E;
+    auto It = Substitutions.find(PE);
+    if (It == Substitutions.end()) {
+      llvm_unreachable("This type of expressions does not exist in the record");
+    }
+    auto &SF = It->second;
+
+    auto S = SF.Parent.lookup(E);
+    if (Direct) return S ? S : E;
+    if (!S || S == E) break;
 
-  if (Direct) {
-    auto S = MA[E];
-    if (S) return S;
-    return E;
+    // Jump over the part of the chain that is already compressed
+    auto R = SF.Root.find(E);
+    if (R != SF.Root.end() && R->second.second == SubstitutionEpoch)
+      S = R->second.first;
+
+    assert(S != E && "Substitution cannot be a cycle");
+    Path.push_back({&SF, E});
+    E = S;
   }
 
-  while (auto EE = GetSubstitution(E, true)) {
-    assert(EE && "Substitution cannot be null");
-    if (IsBottom(EE) || IsTop(EE)) return EE;
-    if (E == EE) return E;
-    E = EE;
+  for (auto &P : Path) {
+    if (P.second == E) continue;
+    P.first->Root[P.second] = {E, SubstitutionEpoch};
   }
 
   return E;
@@ -457,8 +832,12 @@ RemSubstitution(Expression *E) {
   auto PE = ExprToPExpr[E];
   assert(PE);
 
-  if (Substitutions.count(PE))
-    Substitutions[PE].erase(E);
+  auto It = Substitutions.find(PE);
+  if (It == Substitutions.end()) return;
+
+  It->second.Parent.erase(E);
+  It->second.Root.erase(E);
+  ++SubstitutionEpoch;
 }
 
 Value * SSAPRE::
@@ -524,6 +903,7 @@ AddFactor(FactorExpression *FE, const Expression *PE, const BasicBlock *B) {
   FactorToBlock[FE] = B;
   BlockToFactors[B].push_back(FE);
   FExprs.insert(FE);
+  Stats.Factors++;
 
   // Must be the last
   AddSubstitution(FE, FE);
@@ -580,7 +960,6 @@ MaterializeFactor(FactorExpression *FE, PHINode *PHI) {
     PExprToBlocks.erase(PPE);
     PExprToVersions.erase(PPE);
 
-    PPE->getProto()->dropAllReferences();
     ExpressionAllocator.Deallocate(PPE);
   }
 
@@ -604,6 +983,7 @@ MaterializeFactor(FactorExpression *FE, PHINode *PHI) {
   // Wire FE to PHI
   FactorToPHI[FE] = PHI;
   PHIToFactor[PHI] = FE;
+  FactoredPHIs.insert(PHI);
 
   InstToVExpr[PHI] = FE;
   VExprToInst[FE] = PHI;
@@ -658,14 +1038,14 @@ ReplaceFactorMaterialized(FactorExpression * FE, Expression * VE,
       !(FactorExpression::classof(VE) && !FactorToPHI[(FactorExpression*)VE])) {
     auto V = (Value *)ExpToValue[VE];
     PHI->replaceAllUsesWith(V);
-    SSAPREInstrSubstituted++;
+    Stats.InstrSubstituted++;
   }
 
   FE->setIsMaterialized(false);
   PHIToFactor[PHI] = nullptr;
   FactorToPHI[FE] = nullptr;
 
-  KillList.push_back(PHI);
+  AddToKillList(PHI);
 
   // The rest is the same as for non-materialized Factor
   ReplaceFactorFinalize(FE, VE, HRU, Direct);
@@ -690,7 +1070,7 @@ ReplaceFactorFinalize(FactorExpression *FE, Expression *VE,
       if (F->getVExpr(BB) != FE) continue;
 
       F->setVExpr(BB, VE);
-      F->setHasRealUse(VE, HRU);
+      F->setHasRealUse(BB, HRU);
 
       // If we assign the same version we create a cycle
       if (F->getVersion() == VE->getVersion()) {
@@ -700,7 +1080,7 @@ ReplaceFactorFinalize(FactorExpression *FE, Expression *VE,
         if (IsInductionExpression(F, VE)) {
           KillFactor(F);
         } else {
-          F->setIsCycle(VE, true);
+          F->setIsCycle(BB, true);
         }
       }
     }
@@ -709,9 +1089,13 @@ ReplaceFactorFinalize(FactorExpression *FE, Expression *VE,
   // Any Expression of the same type and version follows this Factor occurrence
   // by definition, since we replace the factor with another Expression we can
   // remove all other expressions of the same version and replace their usage
-  // with this new one.
+  // with this new one. A useless Factor leaves them as they are, they must not
+  // lead others to a bottom, which may still get here through a PHI's operands.
   for (auto V : GetSameVExpr(FE)) {
-    AddSubstitution(V, VE, Direct);
+    if (IsBottom(VE))
+      AddSubstitution(V, V, /* direct */ true);
+    else
+      AddSubstitution(V, VE, Direct);
   }
 
   // If we replace the Factor with a newly created expression we need to assign
@@ -760,6 +1144,8 @@ FillInBasicExpressionInfo(Instruction &I, BasicExpression *E) {
 
   bool AllConstant = true;
 
+  E->allocateOperands(ExpressionAllocator, I.getNumOperands());
+
   // ??? This is a bit weird, do i actually need this?
   if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
     E->setType(GEP->getSourceElementType());
@@ -769,7 +1155,10 @@ FillInBasicExpressionInfo(Instruction &I, BasicExpression *E) {
 
   E->setOpcode(I.getOpcode());
 
-  for (auto &O : I.operands()) {
+  for (Value *O : I.operands()) {
+    // A PHI operand is bound to its edge, it is left as it is
+    if (!isa<PHINode>(I)) O = GetLeader(O);
+
     if (auto *C = dyn_cast<Constant>(O)) {
       AllConstant &= true;
 
@@ -787,6 +1176,43 @@ FillInBasicExpressionInfo(Instruction &I, BasicExpression *E) {
   return AllConstant;
 }
 
+Value *SSAPRE::
+GetLeader(Value *V) {
+  auto L = Leaders.lookup(V);
+  return L ? L : V;
+}
+
+void SSAPRE::
+AssignLeader(Instruction &I, const Expression *PE, Expression *VE) {
+  if (auto CE = dyn_cast<ConstantExpression>(VE)) {
+    Leaders[&I] = &CE->getConstant();
+    return;
+  } else if (auto VA = dyn_cast<VariableExpression>(VE)) {
+    Leaders[&I] = &VA->getValue();
+    return;
+  }
+
+  // Only a computation that depends on nothing but its operands is congruent
+  // to another one with the same operands
+  if (IgnoreExpression(PE) || !isa<BasicExpression>(PE) ||
+      isa<PHIExpression>(PE) || isa<MemoryExpression>(PE))
+    return;
+
+  // Blocks are visited in RPO, every root that dominates I is already known.
+  // The latest roots are the closest, only a few of them are tried.
+  auto B = I.getParent();
+  auto &Roots = PExprToRoots[PE];
+  unsigned Tries = 16;
+  for (auto RI = Roots.rbegin(), RE = Roots.rend(); RI != RE && Tries--; ++RI) {
+    auto RB = (*RI)->getParent();
+    if (RB == B || DT->dominates(RB, B)) {
+      Leaders[&I] = *RI;
+      return;
+    }
+  }
+  Roots.push_back(&I);
+}
+
 std::pair<unsigned, unsigned> SSAPRE::
 AssignDFSNumbers(BasicBlock *B, unsigned Start, InstrToOrderType *M) {
   unsigned End = Start;
@@ -950,16 +1376,121 @@ CreatePHIExpression(PHINode &I) {
   return E;
 }
 
-FactorExpression *SSAPRE::
-CreateFactorExpression(const Expression &PE, const BasicBlock &B) {
-  auto FE = new (ExpressionAllocator) FactorExpression(B);
+Expression *SSAPRE::
+CreateAggregateValueExpression(Instruction &I) {
+  ArrayRef<unsigned> Idxs;
+  if (auto *EI = dyn_cast<ExtractValueInst>(&I))
+    Idxs = EI->getIndices();
+  else
+    Idxs = cast<InsertValueInst>(I).getIndices();
+
+  auto IA = ExpressionAllocator.Allocate<unsigned>(Idxs.size());
+  std::copy(Idxs.begin(), Idxs.end(), IA);
+  auto *E = new (ExpressionAllocator) AggregateValueExpression(IA, Idxs.size());
+  FillInBasicExpressionInfo(I, E);
+
+  // Classes are lexical, an extract of a redundant aggregate reads its leader
+  // instead, so that it joins the class of the leader's extracts
+  if (isa<ExtractValueInst>(I))
+    if (auto L = AggregateToLeader.lookup(E->getOperand(0)))
+      E->setOperand(0, L);
+
+  Value *V = isa<ExtractValueInst>(I)
+    ? SimplifyExtractValueInst(E->getOperand(0), Idxs, *DL, TLI, DT, AC)
+    : SimplifyInsertValueInst(E->getOperand(0), E->getOperand(1), Idxs,
+                              *DL, TLI, DT, AC);
+  if (auto *SE = CheckSimplificationResults(E, I, V))
+    return SE;
+
+  return E;
+}
+
+Expression *SSAPRE::
+CreateLoadExpression(LoadInst &I) {
+  // Volatile and atomic loads are left alone
+  if (!I.isSimple()) return nullptr;
+
+  // A clone that is yet to be inserted does not have an access, it is set
+  // once the instruction is placed
+  MemoryAccess *MA = nullptr;
+  if (MSSA->getMemoryAccess(&I))
+    MA = MSSAWalker->getClobberingMemoryAccess(&I);
+
+  auto *E = new (ExpressionAllocator) LoadExpression(I.getAlignment(), MA);
+  FillInBasicExpressionInfo(I, E);
+  return E;
+}
+
+Expression *SSAPRE::
+CreateCallExpression(CallInst &I) {
+  // Only calls that compute a value out of their arguments and possibly the
+  // memory they read, nothing else
+  if (I.getType()->isVoidTy() || !I.onlyReadsMemory() || I.mayThrow() ||
+      I.isConvergent() || I.isInlineAsm() || I.isMustTailCall() ||
+      I.hasOperandBundles())
+    return nullptr;
+
+  // Same as for loads, a clone that is yet to be inserted does not have an
+  // access
+  MemoryAccess *MA = nullptr;
+  if (!I.doesNotAccessMemory() && MSSA->getMemoryAccess(&I))
+    MA = MSSAWalker->getClobberingMemoryAccess(&I);
+
+  auto *E = new (ExpressionAllocator) CallExpression(MA);
+  FillInBasicExpressionInfo(I, E);
+  return E;
+}
+
+const FactorPredecessors &SSAPRE::
+GetFactorPredecessors(const BasicBlock &B) {
+  auto &FP = BlockToPreds[&B];
+  if (FP) return *FP;
 
   // The order we add these blocks is not important, since these blocks only
   // used to get proper Operands and Versions out of the Expression.
-  for (auto S = pred_begin(&B), EE = pred_end(&B); S != EE; ++S) {
+  SmallVector<BasicBlock *, 8> Blocks;
+  SmallVector<unsigned, 8> Mult;
+  SmallDenseMap<BasicBlock *, unsigned, 8> Seen;
+  unsigned NumEdges = 0;
+  for (auto S = pred_begin(&B), EE = pred_end(&B); S != EE; ++S, ++NumEdges) {
     auto PB = (BasicBlock *)*S;
-    FE->addPred(PB, FE->getVExprNum());
 
+    // Even if there are multiple edges from the same predecessor we store only
+    // once
+    auto It = Seen.insert({PB, Blocks.size()});
+    if (!It.second) {
+      Mult[It.first->second]++;
+      continue;
+    }
+
+    Blocks.push_back(PB);
+    Mult.push_back(1);
+  }
+
+  unsigned N = Blocks.size();
+  unsigned TS = FactorPredecessors::getTableSize(N);
+  auto BA = ExpressionAllocator.Allocate<BasicBlock *>(N);
+  auto MA = ExpressionAllocator.Allocate<unsigned>(N);
+  std::copy(Blocks.begin(), Blocks.end(), BA);
+  std::copy(Mult.begin(), Mult.end(), MA);
+  auto KA = ExpressionAllocator.Allocate<const BasicBlock *>(TS);
+  auto IA = ExpressionAllocator.Allocate<unsigned>(TS);
+  FP = new (ExpressionAllocator)
+    FactorPredecessors(BA, MA, N, NumEdges, KA, IA, TS);
+  return *FP;
+}
+
+FactorExpression *SSAPRE::
+CreateFactorExpression(const Expression &PE, const BasicBlock &B) {
+  auto &FP = GetFactorPredecessors(B);
+  auto N = FP.size();
+  auto W = FactorExpression::getNumBitWords(N);
+  auto Versions = ExpressionAllocator.Allocate<Expression *>(N);
+  auto Bits = ExpressionAllocator.Allocate<uint64_t>(2 * W);
+  auto FE = new (ExpressionAllocator)
+    FactorExpression(B, FP, Versions, Bits, Bits + W);
+
+  for (auto PB : FP.getBlocks()) {
     // Make sure this block is reachable and make bugpoint happy
     if (!ValueToExp[PB->getTerminator()]) FE->setVExpr(PB, GetBottom());
   }
@@ -980,19 +1511,19 @@ CreateExpression(Instruction &I) {
   switch (I.getOpcode()) {
   case Instruction::ExtractValue:
   case Instruction::InsertValue:
-    // E = performSymbolicAggrValueEvaluation(I);
+    E = CreateAggregateValueExpression(I);
     break;
   case Instruction::PHI:
     E = CreatePHIExpression(cast<PHINode>(I));
     break;
   case Instruction::Call:
-    // E = performSymbolicCallEvaluation(I);
+    E = CreateCallExpression(cast<CallInst>(I));
     break;
   case Instruction::Store:
     // E = performSymbolicStoreEvaluation(I);
     break;
   case Instruction::Load:
-    // E = performSymbolicLoadEvaluation(I);
+    E = CreateLoadExpression(cast<LoadInst>(I));
     break;
   case Instruction::Trunc:
   case Instruction::ZExt:
@@ -1010,7 +1541,7 @@ CreateExpression(Instruction &I) {
     break;
   case Instruction::ICmp:
   case Instruction::FCmp:
-    // E = performSymbolicCmpEvaluation(I);
+    E = CreateBasicExpression(I);
     break;
   case Instruction::Add:
   case Instruction::FAdd:
@@ -1058,19 +1589,12 @@ namespace ssapre {
 namespace phi_factoring {
 typedef const Expression * Token_t;
 
-struct PropDst_t {
-  // Token know thus far
-  Token_t TOK;
-  // Destination that expects a new Token that is coalculate using TOK
-  const PHINode * DST;
-
-  PropDst_t() = delete;
-  PropDst_t(Token_t TOK, const PHINode *DST)
-    : TOK(TOK), DST(DST) {}
-};
-
-Token_t GetTopTok() { return (Expression *)0x704; }
-Token_t GetBotTok() { return (Expression *)0x807; }
+// The Top and Bottom tokens only need addresses no Expression can have, the
+// objects behind them are never accessed
+static const Expression *const TopTokTag = nullptr;
+static const Expression *const BotTokTag = nullptr;
+Token_t GetTopTok() { return (Token_t)&TopTokTag; }
+Token_t GetBotTok() { return (Token_t)&BotTokTag; }
 bool IsTopTok(Token_t T) { return T == GetTopTok(); }
 bool IsBotTok(Token_t T) { return T == GetBotTok(); }
 bool IsTopOrBottomTok(Token_t T) { return IsTopTok(T) || IsBotTok(T); }
@@ -1108,13 +1632,6 @@ CalculateToken(Token_t A, Token_t B) {
   return GetBotTok();
 }
 
-typedef DenseMap<const PHINode *, const FactorExpression *> PHIFactorMap_t;
-typedef DenseMap<const PHINode *, Token_t> PHITokenMap_t;
-typedef SmallVector<PropDst_t, 8> PropDstVector_t;
-typedef DenseMap<const PHINode *, PropDstVector_t> SrcPropMap_t;
-typedef DenseMap<const PHINode *, bool> PHIBoolMap_t;
-typedef SmallVector<const PHINode *, 8> PHIVector_t;
-
 enum TokenPropagationSolverType {
   // Accurate solver does gurantee that all factors it contains after the
   // executation have corret Token(PE) assigned to them
@@ -1125,234 +1642,430 @@ enum TokenPropagationSolverType {
   TPST_Approximation
 };
 
+// Solver state of a single PHI, the PHI is a node in a graph that has an edge
+// from every PHI to each of its PHI operands(single-operand PHIs are looked
+// through), so the SCCs of the graph come out operands first.
+struct PHIState {
+  const PHINode *PHI;
+  // Meet of all the non-PHI operands
+  Token_t Base;
+  // Current Token, it starts at Top and only goes down
+  Token_t TOK;
+  // SCC the PHI belongs to, zero until the SCC is reached
+  unsigned SCC;
+  // Factor of a PHI with a legal Token
+  const FactorExpression *F;
+  SmallVector<PHIState *, 2> Operands;
+  SmallVector<PHIState *, 2> Users;
+
+  PHIState(const PHINode *PHI)
+    : PHI(PHI), Base(GetTopTok()), TOK(GetTopTok()), SCC(0), F(nullptr) {}
+};
+
+struct PHIGraph {
+  // Node 0 is a virtual root with an edge to every PHI, the rest are PHIs in
+  // the JoinBlocks order
+  SmallVector<PHIState, 32> Nodes;
+};
+
+typedef SmallVector<std::pair<const PHINode *, const FactorExpression *>, 8>
+  LiveFactors_t;
+} // namespace phi_factoring
+} // namespace ssapre
+
+template <> struct GraphTraits<ssapre::phi_factoring::PHIGraph *> {
+  typedef ssapre::phi_factoring::PHIState *NodeRef;
+  typedef SmallVectorImpl<NodeRef>::iterator ChildIteratorType;
+
+  static NodeRef getEntryNode(ssapre::phi_factoring::PHIGraph *G) {
+    return &G->Nodes.front();
+  }
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->Operands.begin();
+  }
+  static ChildIteratorType child_end(NodeRef N) { return N->Operands.end(); }
+};
+
+namespace ssapre {
+namespace phi_factoring {
 class TokenPropagationSolver {
   TokenPropagationSolverType TPST;
   SSAPRE &O;
-  PHIFactorMap_t PHIFactorMap;
-  PHITokenMap_t PHITokenMap;
-  SrcPropMap_t SrcPropMap;
-  PHIBoolMap_t SrcKillMap;
-  PHIBoolMap_t FinishedMap;
-
-public:
-  TokenPropagationSolver() = delete;
-  TokenPropagationSolver(TokenPropagationSolverType TPST, SSAPRE &O)
-    : TPST(TPST), O(O) {}
+  PHIGraph G;
+  DenseMap<const PHINode *, unsigned> PHIIndex;
+  LiveFactors_t LiveFactors;
+
+  PHIState *
+  GetState(const PHINode *PHI) {
+    auto It = PHIIndex.find(PHI);
+    return It == PHIIndex.end() ? nullptr : &G.Nodes[It->second];
+  }
 
   void
-  CreateFactor(const PHINode *PHI, Token_t PE) {
-    auto E = PHIFactorMap[PHI];
-    assert(!E && "FE already exists");
-    E = O.CreateFactorExpression(*PE, *PHI->getParent());
-    PHIFactorMap[PHI] = E;
-    SrcKillMap[PHI] = false;
-    FinishedMap[PHI] = false;
+  Build() {
+    // Every PHI gets its slot first, so the states do not move while they are
+    // linked together
+    G.Nodes.push_back(PHIState(nullptr));
+    for (auto B : O.JoinBlocks) {
+      for (auto &I : *B) {
+        auto PHI = dyn_cast<PHINode>(&I);
+        if (!PHI) break;
+
+        PHIIndex.insert({PHI, G.Nodes.size()});
+        G.Nodes.push_back(PHIState(PHI));
+      }
+    }
+
+    for (unsigned n = 1, e = G.Nodes.size(); n < e; ++n) {
+      auto &S = G.Nodes[n];
+      G.Nodes.front().Operands.push_back(&S);
+
+      auto PHIVE = O.ValueToExp[S.PHI];
+      for (unsigned i = 0, l = S.PHI->getNumOperands(); i < l; ++i) {
+        auto Op = S.PHI->getOperand(i);
+
+        // Can happen after other optimization passes
+        while (auto OPHI = dyn_cast<PHINode>(Op)) {
+          if (OPHI->getNumOperands() != 1) break;
+          Op = OPHI->getIncomingValue(0);
+        }
+        auto OVE = O.ValueToExp[Op];
+
+        // Self-loop gives an optimistic Top value
+        if (OVE == PHIVE) continue;
+
+        // Ignored expressions produce Bottom value right away. So do those
+        // reading memory, their PHIs can be proven to be Factors only by
+        // comparing memory states at the predecessors' ends, which is done
+        // during Rename.
+        if (IgnoredExpression::classof(OVE) ||
+            UnknownExpression::classof(OVE) ||
+            (MemoryExpression::classof(OVE) &&
+             O.ReadsMemory(O.ExprToPExpr[OVE]))) {
+          S.Base = GetBotTok();
+          break;
+        }
+
+        // A variable or a constant regarded as Bottom value
+        if (O.IsVariableOrConstant(OVE)) {
+          S.Base = CalculateToken(S.Base,
+              TPST == TPST_Approximation ? GetTopTok() : GetBotTok());
+
+        // PHI operands are left to the SCC walk, a PHI outside of the join
+        // blocks is never resolved and gives Bottom
+        } else if (auto OPHI = dyn_cast<PHINode>(Op)) {
+          if (auto OS = GetState(OPHI)) {
+            S.Operands.push_back(OS);
+            OS->Users.push_back(&S);
+          } else {
+            S.Base = GetBotTok();
+          }
+
+        // Otherwise we use whatever this VE is prototyped by
+        } else {
+          S.Base = CalculateToken(S.Base, O.ExprToPExpr[OVE]);
+        }
+
+        if (IsBotTok(S.Base)) break;
+      }
+    }
   }
 
-  bool
-  HasTokenFor(const PHINode *PHI) {
-    return PHITokenMap.count(PHI) != 0;
+  Token_t
+  Evaluate(const PHIState &S) {
+    // Token is a meet of all the PHI's operands
+    auto TOK = S.Base;
+    for (auto OS : S.Operands) {
+      if (IsBotTok(TOK)) break;
+      TOK = CalculateToken(TOK, OS->TOK);
+    }
+    return TOK;
+  }
+
+  void
+  SolveSCC(const std::vector<PHIState *> &SCC, unsigned ID) {
+    // Operands outside of the SCC are final by now. Inside of it every PHI
+    // starts at Top and we lower the Tokens until nothing changes, since a
+    // Token goes down at most twice(Top, Expression, Bottom) every PHI is
+    // revisited only a bounded number of times.
+    SmallVector<PHIState *, 8> Worklist(SCC.rbegin(), SCC.rend());
+    while (!Worklist.empty()) {
+      auto S = Worklist.pop_back_val();
+      auto TOK = Evaluate(*S);
+      if (TOK == S->TOK) continue;
+
+      S->TOK = TOK;
+      for (auto U : S->Users)
+        if (U->SCC == ID) Worklist.push_back(U);
+    }
   }
 
+public:
+  TokenPropagationSolver() = delete;
+  TokenPropagationSolver(TokenPropagationSolverType TPST, SSAPRE &O)
+    : TPST(TPST), O(O) {}
+
   Token_t
   GetTokenFor(const PHINode *PHI) {
     if (HasFactorFor(PHI))
-      return PHITokenMap[PHI];
-    return GetBottom();
+      return GetState(PHI)->TOK;
+    return O.GetBottom();
   }
 
   bool
   HasFactorFor(const PHINode *PHI) {
-    return PHIFactorMap.count(PHI) != 0;
-  }
-
-  bool
-  IsFinished(const PHINode *PHI) {
-    assert(HasFactorFor(PHI));
-    return FinishedMap[PHI];
+    auto S = GetState(PHI);
+    return S && S->F;
   }
 
   const FactorExpression *
   GetFactorFor(const PHINode *PHI) {
     assert(HasFactorFor(PHI));
-    return PHIFactorMap[PHI];
+    return GetState(PHI)->F;
   }
 
-  PHIFactorMap_t GetLiveFactors() { return PHIFactorMap; }
-
-  void
-  AddPropagations(Token_t T, const PHINode *S, PHIVector_t DL) {
-    for (auto D : DL) { AddPropagation(T, S, D); }
-  }
+  const LiveFactors_t & GetLiveFactors() { return LiveFactors; }
 
   void
-  AddPropagation(Token_t T, const PHINode *S, const PHINode *D) {
-    if (!HasFactorFor(S)) CreateFactor(S, T);
-    if (!HasFactorFor(D)) CreateFactor(D, T);
+  Solve() {
+    // Tokens form a lattice Top > Expression > Bottom over the PHI graph. We
+    // walk its SCCs operands first, so every PHI outside of the current SCC
+    // already has its final Token, and solve the SCC optimistically: cycle
+    // PHIs are assumed Top until proven otherwise. Each PHI and each operand
+    // edge are visited a bounded number of times. By the end of this walk we
+    // will have a set of Factors that have a legal Token as their Prototype
+    // Expression, the PHIs that got either a Top or a Bottom have none.
+    Build();
+
+    unsigned ID = 0;
+    for (auto I = scc_begin(&G), E = scc_end(&G); I != E; ++I) {
+      // The virtual root comes last and is alone in its SCC
+      if (!(*I).front()->PHI) continue;
+
+      ++ID;
+      for (auto S : *I) S->SCC = ID;
+      SolveSCC(*I, ID);
+    }
 
-    SrcKillMap[D] = IsBotTok(T);
+    for (unsigned n = 1, e = G.Nodes.size(); n < e; ++n) {
+      auto &S = G.Nodes[n];
+      if (IsTopOrBottomTok(S.TOK)) continue;
 
-    if (!SrcPropMap.count(S)) {
-      SrcPropMap.insert({S, {{T, D}}});
-    } else {
-      SrcPropMap[S].push_back({T, D});
+      S.F = O.CreateFactorExpression(*S.TOK, *S.PHI->getParent());
+      LiveFactors.push_back({S.PHI, S.F});
     }
   }
+};
+} // namespace phi_factoring
 
-  void
-  FinishPropagation(Token_t T, const PHINode *PHI) {
-    assert(!SrcKillMap[PHI] && "The Factor is already killed");
-
-    if (!HasFactorFor(PHI)) CreateFactor(PHI, T);
-    PHITokenMap[PHI] = T;
+// Profile-guided placement solver
+namespace min_cut {
+// Minimum source-sink cut over a Factor graph of a single expression, this is
+// the core of MC-SSAPRE by Zhou, Chen and Chow. Node 0 is the source, node 1
+// is the sink, the rest are Factors. The graphs are small, so a plain
+// Edmonds-Karp is used.
+class MinCutSolver {
+public:
+  static const uint64_t Infinity = ~0ULL;
+  static const unsigned Source = 0;
+  static const unsigned Sink = 1;
 
-    // Either Top or Bottom results in deletion of the Factor
-    SrcKillMap[PHI] = IsTopOrBottomTok(T);
+private:
+  struct Edge_t {
+    unsigned To;
+    // Index of the reverse edge in Edges
+    unsigned Rev;
+    uint64_t Cap;
+  };
 
-    FinishedMap[PHI] = true;
+  std::vector<Edge_t> Edges;
+  std::vector<SmallVector<unsigned, 4>> Out;
 
-    if (!SrcPropMap.count(PHI)) return;
+  // Nodes that still reach the sink in the residual graph
+  BitVector ReachesSink;
 
-    // Recursively finish every propagation
-    for (auto &PD : SrcPropMap[PHI]) {
-      auto R = CalculateToken(T, PD.TOK);
-      FinishPropagation(R, PD.DST);
-    }
+  void addEdgeInternal(unsigned From, unsigned To, uint64_t Cap) {
+    Out[From].push_back(Edges.size());
+    Edges.push_back({To, (unsigned)Edges.size() + 1, Cap});
+    Out[To].push_back(Edges.size());
+    Edges.push_back({From, (unsigned)Edges.size() - 1, 0});
   }
 
-  void
-  Cleanup() {
-    // Erase all killed Factors before returning the Map
-    for (auto P : SrcKillMap) {
-      if (!P.getSecond()) continue;
-
-      O.ExpressionAllocator.Deallocate(P.getFirst());
-      auto PHI = P.getFirst();
-      PHIFactorMap.erase(PHI);
-      PHITokenMap.erase(PHI);
+  // Find a shortest augmenting path and push the flow along it, returns false
+  // if there is none
+  bool augment() {
+    SmallVector<unsigned, 16> Via(Out.size(), ~0U);
+    SmallVector<unsigned, 16> Queue;
+    Via[Source] = 0;
+    Queue.push_back(Source);
+    for (unsigned i = 0; i < Queue.size() && Via[Sink] == ~0U; ++i) {
+      auto N = Queue[i];
+      for (auto EI : Out[N]) {
+        auto &E = Edges[EI];
+        if (!E.Cap || Via[E.To] != ~0U) continue;
+        Via[E.To] = EI;
+        Queue.push_back(E.To);
+      }
     }
+    if (Via[Sink] == ~0U) return false;
+
+    uint64_t Flow = Infinity;
+    for (auto N = Sink; N != Source; N = Edges[Edges[Via[N]].Rev].To)
+      Flow = std::min(Flow, Edges[Via[N]].Cap);
+
+    // Every path ends with a finite Factor-to-sink edge
+    assert(Flow != Infinity && "Unbounded flow");
+    for (auto N = Sink; N != Source; N = Edges[Edges[Via[N]].Rev].To) {
+      auto &E = Edges[Via[N]];
+      if (E.Cap != Infinity) E.Cap -= Flow;
+      auto &R = Edges[E.Rev];
+      if (R.Cap != Infinity) R.Cap = SaturatingAdd(R.Cap, Flow);
+    }
+    return true;
   }
 
-  void
-  Solve() {
-    // Top-Down walk over join blocks set and try to calculate current PHIs PE.
-    // If it happens that some operand of this PHI is produced by another PHI
-    // that we yet to meet(back branch) we create a propagation record that
-    // stores partial Token and these two PHIs as Source and Destination. If we
-    // can calculate a Token immediately we "finish" current PHI and propagate
-    // its Token to other PHIs that depend on it recursively. By the end of
-    // this walk we will have a set of Factors that have either a legal Token
-    // or a Bottom value as their Prototype Expression.
-    for (auto B : O.JoinBlocks) {
-      for (auto &I : *B) {
-
-        // When we reach first non-phi instruction we stop
-        if (&I == B->getFirstNonPHI()) break;
-
-        auto PHI = dyn_cast<PHINode>(&I);
-        if (!PHI) continue;
-
-        auto PHIVE = O.ValueToExp[PHI];
-
-        // Token is a meet of all the PHI's operands. We optimistically set it
-        // initially to Top
-        Token_t TOK = GetTopTok();
-
-        // Back Branch source
-        const PHINode * BackBranch = nullptr;
-
-
-        for (unsigned i = 0, l = PHI->getNumOperands(); i < l; ++i) {
-          auto Op = PHI->getOperand(i);
-          auto OVE = O.ValueToExp[Op];
-
-          // Can happen after other optimization passes
-          while (auto OPHI = dyn_cast<PHINode>(Op)) {
-            if (OPHI->getNumOperands() != 1) break;
-            Op = OPHI->getIncomingValue(0);
-            OVE = O.ValueToExp[Op];
-          }
-
-          // Self-loop gives an optimistic Top value
-          if (OVE == PHIVE) {
-            TOK = GetTopTok();
-            continue;
-          }
-
-          // Ignored expressions produce Bottom value right away
-          if (IgnoredExpression::classof(OVE) ||
-              UnknownExpression::classof(OVE)) {
-            TOK = GetBotTok();
-            break;
-          }
-
-          // A variable or a constant regarded as Bottom value
-          if (O.IsVariableOrConstant(OVE)) {
-            TOK = CalculateToken(TOK,
-                TPST == TPST_Approximation ? GetTopTok() : GetBotTok());
+public:
+  MinCutSolver(unsigned NumFactors) : Out(NumFactors + 2) {}
+  MinCutSolver() = delete;
+  MinCutSolver(const MinCutSolver &) = delete;
+  MinCutSolver &operator=(const MinCutSolver &) = delete;
 
-            continue;
-          }
+  static unsigned getNode(unsigned FactorIndex) { return FactorIndex + 2; }
 
-          if (auto OPHI = dyn_cast<PHINode>(Op)) {
+  void addEdge(unsigned From, unsigned To, uint64_t Cap) {
+    assert(From != Sink && To != Source);
+    if (Cap) addEdgeInternal(From, To, Cap);
+  }
 
-            if (!HasFactorFor(OPHI)) {
-              TOK = CalculateToken(TOK, GetTopTok());
+  // Returns the number of augmenting paths found
+  unsigned Solve() {
+    unsigned Steps = 0;
+    while (augment()) Steps++;
+
+    // Of all minimum cuts we take the one closest to the sink, ties between
+    // an insertion and a computation left in place are resolved in favor of
+    // the latter
+    ReachesSink.resize(Out.size());
+    SmallVector<unsigned, 16> Worklist;
+    ReachesSink.set(Sink);
+    Worklist.push_back(Sink);
+    while (!Worklist.empty()) {
+      auto N = Worklist.pop_back_val();
+      for (auto EI : Out[N]) {
+        // An edge into N has residual capacity if its reverse one does not
+        // carry all of it
+        auto &R = Edges[Edges[EI].Rev];
+        auto From = Edges[EI].To;
+        if (!R.Cap || ReachesSink.test(From)) continue;
+        ReachesSink.set(From);
+        Worklist.push_back(From);
+      }
+    }
 
-              // It is more like a sane precaution during development phase;
-              // the solver can be changed to handle multiple back-branches,
-              // but I have yet to encounter a block that has more than one and
-              // thus this "feature" is not implemented
-              assert(!BackBranch && "Must not be a second Back Branch");
-              BackBranch = OPHI;
+    return Steps;
+  }
 
-            } else {
-              Token_t T = IsFinished(OPHI) ? GetTokenFor(OPHI) : GetTopTok();
-              TOK = CalculateToken(TOK, T);
-            }
+  // After Solve, a Factor on the sink side of the cut is made available
+  bool getIsSinkSide(unsigned FactorIndex) const {
+    return ReachesSink.test(getNode(FactorIndex));
+  }
+};
+} // namespace min_cut
+} // namespace ssapre
+} // namespace llvm
 
-            continue;
+//===----------------------------------------------------------------------===//
+// Pass Implementation
+//===----------------------------------------------------------------------===//
 
-            // Otherwise we use whatever this VE is prototyped by
-          } else {
-            TOK = CalculateToken(TOK, O.ExprToPExpr[OVE]);
+bool SSAPRE::
+IsSinkableStore(const StoreInst *S, const StoreInst *First,
+                const BasicBlock *B) {
+  if (!S->isSimple()) return false;
+
+  if (First)
+    return S->getPointerOperand() == First->getPointerOperand() &&
+           S->getValueOperand()->getType() ==
+               First->getValueOperand()->getType() &&
+           S->getAlignment() == First->getAlignment();
+
+  // The address must be available at the start of the join
+  auto Ptr = dyn_cast<Instruction>(S->getPointerOperand());
+  return !Ptr || DT->properlyDominates(Ptr->getParent(), B);
+}
 
-            continue;
-          }
-        }
+bool SSAPRE::
+StoreSinking() {
+  bool Changed = false;
 
-        // This PHI has back branches and we are still not sure whether it is a
-        // materialized Factor.
-        if (BackBranch) {
+  // Blocks are visited in RPO, a store sunk into a join may be sunk again
+  // into the join that follows it
+  for (auto B : RPOBlocks) {
+    if (B->isEHPad()) continue;
+
+    // Predecessors that store to the same address meet at a MemoryPhi
+    auto MP = MSSA->getMemoryAccess(B);
+    if (!MP) continue;
+
+    // Every predecessor leads only to B and ends with a store of the same
+    // class, so B stores on every path through it
+    SmallVector<StoreInst *, 8> Stores;
+    for (auto P : predecessors(B)) {
+      StoreInst *S = nullptr;
+      auto Accesses = MSSA->getBlockAccesses(P);
+      if (P->getSingleSuccessor() == B && Accesses)
+        if (auto MD = dyn_cast<MemoryDef>(&Accesses->back()))
+          S = dyn_cast_or_null<StoreInst>(MD->getMemoryInst());
+
+      if (!S || !IsSinkableStore(S, Stores.empty() ? nullptr : Stores[0], B)) {
+        Stores.clear();
+        break;
+      }
+      Stores.push_back(S);
+    }
+    if (Stores.size() < 2) continue;
+
+    // The stored values meet in a PHI unless they are all the same
+    auto S0 = Stores[0];
+    Value *V = S0->getValueOperand();
+    if (any_of(Stores, [&](const StoreInst *S) {
+          return S->getValueOperand() != V;
+        })) {
+      auto PHI = PHINode::Create(V->getType(), Stores.size(),
+                                 "storemerge", &B->front());
+      for (auto S : Stores)
+        PHI->addIncoming(S->getValueOperand(), S->getParent());
+      V = PHI;
+    }
 
-          // Even with the back branch if the TOK is bottom it won't change and
-          // we can finish its "propagation" right now
-          if (IsBotTok(TOK)) {
-            FinishPropagation(TOK, PHI);
+    auto NS = cast<StoreInst>(S0->clone());
+    NS->setOperand(0, V);
+    for (auto S : Stores) {
+      combineMetadataForCSE(NS, S);
+      NS->setDebugLoc(DILocation::getMergedLocation(NS->getDebugLoc(),
+                                                    S->getDebugLoc()));
+    }
+    NS->insertBefore(&*B->getFirstInsertionPt());
 
-          // Or we have either an Expression or Top value to propagate
-          // upwards. We get/create Factors for current PHI and its cycle PHI
-          // operands and link them appropriately.
-          } else {
-            AddPropagation(TOK, /* Source */ BackBranch, /* Destination */ PHI);
-          }
+    for (auto S : Stores) {
+      MSSAU->removeMemoryAccess(MSSA->getMemoryAccess(S));
+      S->eraseFromParent();
+      Stats.StoresSunk++;
+    }
 
-        } else {
-          FinishPropagation(TOK, PHI);
-        }
-      }
+    // The new store is the first definition in B, everything that saw the
+    // MemoryPhi now sees the store
+    auto ND = MSSAU->createMemoryAccessInBB(NS, MP, B, MemorySSA::Beginning);
+    for (auto UI = MP->use_begin(), UE = MP->use_end(); UI != UE;) {
+      Use &U = *UI++;
+      if (U.getUser() != ND) U.set(ND);
     }
 
-    Cleanup();
+    Changed = true;
   }
-};
-} // namespace phi_factoring
-} // namespace ssapre
-} // namespace llvm
 
-//===----------------------------------------------------------------------===//
-// Pass Implementation
-//===----------------------------------------------------------------------===//
+  return Changed;
+}
 
 void SSAPRE::
 Init(Function &F) {
@@ -1368,6 +2081,10 @@ Init(Function &F) {
     ValueToVAExp[&A] = VAExp;
   }
 
+  // Every run has its own sentinels, nothing is shared between concurrent runs
+  TopExpr = new (ExpressionAllocator) Expression(ET_Top, ~2U, VR_Top);
+  BottomExpr = new (ExpressionAllocator) Expression(ET_Bottom, ~2U, VR_Bottom);
+
   AddSubstitution(GetBottom(), GetBottom());
 
   // Each block starts its count from N hundred thousands, this will allow us
@@ -1375,9 +2092,12 @@ Init(Function &F) {
   unsigned ICountGrowth = 100000;
   unsigned ICount = ICountGrowth;
 
+  // ProtoExpression-to-Aggregates map, the ones that lead their class
+  DenseMap<const Expression *, SmallVector<Instruction *, 2>> AggregateRoots;
+
   DenseMap<const DomTreeNode *, unsigned> RPOOrdering;
   unsigned Counter = 0;
-  for (auto &B : *RPOT) {
+  for (auto B : RPOBlocks) {
     if (!B->getSinglePredecessor()) {
       JoinBlocks.push_back(B);
     }
@@ -1393,20 +2113,41 @@ Init(Function &F) {
       // Create ProtoExpresison, this expression will not be versioned and used
       // to bind Versioned Expressions of the same kind/class.
       auto PE = CreateExpression(I);
-      for (auto &P : PExprToInsts) {
-        auto EP = P.getFirst();
-        if (PE->equals(*EP))
-          PE = (Expression *)EP;
+      auto PEI = PExprTable.insert(PE);
+      if (!PEI.second) {
+        ExpressionAllocator.Deallocate(PE);
+        PE = (Expression *)*PEI.first;
       }
 
+      // The first occurrence serves as the Prototype's instruction, it stays in
+      // place until the very end of the pass and nothing is cloned for it
       if (!PE->getProto() && !IgnoreExpression(PE)) {
-        PE->setProto(I.clone());
+        PE->setProto(&I);
       }
       // This is the real versioned expression
       Expression *VE = CreateExpression(I);
 
       AddExpression(PE, VE, &I, B);
 
+      // An aggregate is led by the first dominating one of its class, it must
+      // depend on nothing but its operands for the two to hold the same value
+      if (I.getType()->isAggregateType() && !IgnoreExpression(PE) &&
+          isa<BasicExpression>(PE) && !isa<PHIExpression>(PE)) {
+        auto ME = dyn_cast<MemoryExpression>(VE);
+        if (!ME || !ME->getClobberingAccess()) {
+          auto &Roots = AggregateRoots[PE];
+          auto L = find_if(Roots, [&](const Instruction *R) {
+            return DT->dominates(R, &I);
+          });
+          if (L != Roots.end())
+            AggregateToLeader[&I] = *L;
+          else
+            Roots.push_back(&I);
+        }
+      }
+
+      if (SSAPREValueNumbering) AssignLeader(I, PE, VE);
+
       if (!PExprToVersions.count(PE)) {
         PExprToVersions.insert({PE, DenseMap<int,ExpVector_t>()});
       }
@@ -1414,7 +2155,7 @@ Init(Function &F) {
   }
 
   // Sort dominator tree children arrays into RPO.
-  for (auto &B : *RPOT) {
+  for (auto B : RPOBlocks) {
     auto *Node = DT->getNode(B);
     if (Node->getChildren().size() > 1) {
       std::sort(Node->begin(), Node->end(),
@@ -1426,13 +2167,23 @@ Init(Function &F) {
 
   // Assign each instruction a DFS order number. This will be the main order
   // we traverse DT in.
+  SmallVector<BasicBlock *, 32> DTPreorder;
   auto DFI = df_begin(DT->getRootNode());
   for (auto DFE = df_end(DT->getRootNode()); DFI != DFE; ++DFI) {
     auto B = DFI->getBlock();
     auto BlockRange = AssignDFSNumbers(B, ICount, &InstrDFS);
     ICount += BlockRange.second - BlockRange.first + ICountGrowth;
+    // The gap after the block belongs to it, instructions are inserted there
+    DomSubtreeEnd[B] = ICount;
+    DTPreorder.push_back(B);
   }
 
+  // A subtree ends where its last child's subtree does
+  for (auto B : reverse(DTPreorder))
+    for (auto C : DT->getNode(B)->getChildren())
+      DomSubtreeEnd[B] = std::max(DomSubtreeEnd[B],
+                                  DomSubtreeEnd[C->getBlock()]);
+
   // Now we need to create Reverse Sorted Dominator Tree, where siblings sorted
   // in the opposite to RPO order. This order will give us a clue, when during
   // the normal traversal(using loop, not recursion) we go up the tree. For
@@ -1469,7 +2220,7 @@ Init(Function &F) {
   //     a  a  a  d
   //              a
   //
-  for (auto &B : *RPOT) {
+  for (auto B : RPOBlocks) {
     auto *Node = DT->getNode(B);
     if (Node->getChildren().size() > 1) {
       std::sort(Node->begin(), Node->end(),
@@ -1490,7 +2241,7 @@ Init(Function &F) {
   }
 
   // Return DT to RPO order
-  for (auto &B : *RPOT) {
+  for (auto B : RPOBlocks) {
     auto *Node = DT->getNode(B);
     if (Node->getChildren().size() > 1) {
       std::sort(Node->begin(), Node->end(),
@@ -1500,6 +2251,60 @@ Init(Function &F) {
                 });
     }
   }
+
+  SelectTier(F);
+}
+
+void SSAPRE::
+SelectTier(Function &F) {
+  CurrentTier = T_Full;
+
+  // Every class is weighted by its occurrences, or by their frequencies if
+  // there is a profile
+  SmallVector<std::pair<uint64_t, const Expression *>, 64> Classes;
+  for (auto &P : PExprToInsts) {
+    auto PE = P.first;
+    if (IgnoreExpression(PE) || PHIExpression::classof(PE)) continue;
+    uint64_t W = 0;
+    for (auto I : P.second) {
+      auto IW = BFI ? std::max(GetFrequency(I->getParent()), (uint64_t)1) : 1;
+      W = SaturatingAdd(W, IW);
+    }
+    Classes.push_back({W, PE});
+  }
+
+  auto NumInsts = InstToVExpr.size();
+  auto NumClasses = Classes.size();
+  if (NumInsts > SSAPRETierReducedSize || NumClasses > SSAPRETierReducedClasses)
+    CurrentTier = T_Reduced;
+  if (NumInsts > SSAPRETierMinimalSize || NumClasses > SSAPRETierMinimalClasses)
+    CurrentTier = T_Minimal;
+  if (CurrentTier == T_Full) return;
+
+  unsigned NumHot = NumClasses;
+  if (CurrentTier == T_Minimal && NumClasses > SSAPRETierHotClasses) {
+    // Ties go to the earlier class so the choice does not depend on pointers
+    std::sort(Classes.begin(), Classes.end(),
+              [&](const std::pair<uint64_t, const Expression *> &A,
+                  const std::pair<uint64_t, const Expression *> &B) {
+                if (A.first != B.first) return A.first > B.first;
+                return InstrDFS[A.second->getProto()] <
+                       InstrDFS[B.second->getProto()];
+              });
+    NumHot = SSAPRETierHotClasses;
+    for (unsigned i = NumHot; i < NumClasses; ++i)
+      ColdPExprs.insert(Classes[i].second);
+  }
+
+  OptimizationRemarkAnalysis R(DEBUG_TYPE, "Tier", &*F.getEntryBlock().begin());
+  R << "function has " << ore::NV("Instructions", (unsigned)NumInsts)
+    << " instructions and " << ore::NV("Classes", (unsigned)NumClasses)
+    << " expression classes, existing PHIs are not factored and nothing is "
+       "speculated";
+  if (CurrentTier == T_Minimal)
+    R << ", cycles are ignored and only " << ore::NV("HotClasses", NumHot)
+      << " classes get Factors";
+  ORE->emit(R);
 }
 
 void SSAPRE::
@@ -1517,14 +2322,19 @@ Fini() {
 
   InstrDFS.clear();
   InstrSDFS.clear();
+  DomSubtreeEnd.clear();
 
   FactorToPHI.clear();
   PHIToFactor.clear();
 
   InstToVExpr.clear();
   VExprToInst.clear();
+  AggregateToLeader.clear();
   ExprToPExpr.clear();
+  PExprTable.clear();
   PExprToVersions.clear();
+  VersionUses.clear();
+  PHIUses.clear();
   PExprToInsts.clear();
   PExprToBlocks.clear();
   PExprToVExprs.clear();
@@ -1536,8 +2346,47 @@ Fini() {
 
   Substitutions.clear();
   KillList.clear();
+  KillSet.clear();
+
+  FactorUses.clear();
+  BlockToPreds.clear();
+  BlockToMemoryAccess.clear();
+
+  BlockPressure.clear();
+  ValueToLiveIn.clear();
+  FactoredPHIs.clear();
+  PHITranslations.clear();
+  ColdPExprs.clear();
+  Leaders.clear();
+  PExprToRoots.clear();
+
+  // The global counters are shared by concurrent runs, every run adds its own
+  // counts only once it is done
+  {
+    static std::mutex StatisticsLock;
+    std::lock_guard<std::mutex> Lock(StatisticsLock);
+    SSAPREInstrSubstituted += Stats.InstrSubstituted;
+    SSAPREInstrInserted += Stats.InstrInserted;
+    SSAPREInstrKilled += Stats.InstrKilled;
+    SSAPREPHIInserted += Stats.PHIInserted;
+    SSAPREPHIKilled += Stats.PHIKilled;
+    SSAPREFactors += Stats.Factors;
+    SSAPREPropagationSteps += Stats.PropagationSteps;
+    SSAPREStoresSunk += Stats.StoresSunk;
+    SSAPREAugmentingPaths += Stats.AugmentingPaths;
+    SSAPREStrengthReduced += Stats.StrengthReduced;
+    SSAPREEdgesSplit += Stats.EdgesSplit;
+
+    auto Memory = ExpressionAllocator.getTotalMemory();
+    if (Memory > SSAPREAllocatorBytes) SSAPREAllocatorBytes = Memory;
+
+    // Reset keeps the first slab for the next function, only the slabs above
+    // it are allocated anew
+    SSAPRESlabsAllocated += ExpressionAllocator.GetNumSlabs() - RetainedSlabs;
+  }
 
   ExpressionAllocator.Reset();
+  RetainedSlabs = ExpressionAllocator.GetNumSlabs();
 }
 
 void SSAPRE::
@@ -1548,9 +2397,9 @@ FactorInsertionMaterialized() {
 
   // Process proven-to-be materialized Factor/PHIs
   for (auto &P : TokSolver.GetLiveFactors()) {
-    auto PHI = (PHINode *)P.getFirst();
+    auto PHI = (PHINode *)P.first;
     auto B = PHI->getParent();
-    auto F = (FactorExpression *)P.getSecond();
+    auto F = (FactorExpression *)P.second;
     auto T = TokSolver.GetTokenFor(PHI);
 
     if (IgnoreExpression(T)) continue;
@@ -1598,22 +2447,69 @@ FactorInsertionRegular() {
   // Factors are inserted in two cases:
   //   - for each block in expressions IDF
   //   - for each phi of expression operand, which indicates expression
-  //     alteration(TODO, requires operand versioning)
+  //     alteration, the Factor phi-translates the operand. The memory operand
+  //     of loads and calls is the exception, its phis are the MemoryPhis.
+  SmallVector<BasicBlock *, 8> MemoryPhiBlocks;
+  for (auto B : JoinBlocks) {
+    if (MSSA->getMemoryAccess(B))
+      MemoryPhiBlocks.push_back((BasicBlock *)B);
+  }
+
   for (auto &P : PExprToInsts) {
-    auto &PE = P.getFirst();
+    auto &PE = P.first;
 
     // Do not Factor PHIs, obviously
     if (IgnoreExpression(PE) || PHIExpression::classof(PE)) continue;
 
+    // Cold classes are left to the dominance based elimination of Rename
+    if (ColdPExprs.count(PE)) continue;
+
+    auto &Blocks = PExprToBlocks[PE];
+
+    // A MemoryPhi alters an Expression only if it happens before one of its
+    // occurrences, these blocks get a Factor and act as occurrences for IDF
+    SmallPtrSet<BasicBlock *, 32> DefBlocks(Blocks.begin(), Blocks.end());
+    SmallVector<BasicBlock *, 8> AlteredBlocks;
+    if (ReadsMemory(PE)) {
+      for (auto MB : MemoryPhiBlocks) {
+        if (any_of(Blocks,
+                   [&](BasicBlock *B) { return DT->dominates(MB, B); })) {
+          DefBlocks.insert(MB);
+          AlteredBlocks.push_back(MB);
+        }
+      }
+
+    // An operand PHI always happens before the occurrences, a join block that
+    // defines one gets a Factor the same way
+    } else if (auto PR = PE->getProto()) {
+      for (auto &O : PR->operands()) {
+        auto PHI = dyn_cast<PHINode>(O);
+        if (!PHI) continue;
+        auto PB = (BasicBlock *)PHI->getParent();
+        if (PB->getSinglePredecessor() || !HasPHIOperandsAt(PE, PB)) continue;
+        DefBlocks.insert(PB);
+        if (!is_contained(AlteredBlocks, PB)) AlteredBlocks.push_back(PB);
+      }
+    }
+
     // Each Expression occurrence's DF requires us to insert a Factor function,
     // which is much like PHI function but for expressions.
     SmallVector<BasicBlock *, 32> IDF;
     ForwardIDFCalculator IDFs(*DT);
-    IDFs.setDefiningBlocks(PExprToBlocks[PE]);
+    IDFs.setDefiningBlocks(DefBlocks);
     // IDFs.setLiveInBlocks(BlocksWithDeadTerminators);
     IDFs.calculate(IDF);
 
+    for (auto MB : AlteredBlocks) {
+      if (!is_contained(IDF, MB)) IDF.push_back(MB);
+    }
+
     for (const auto &B : IDF) {
+      // The minimal tier does not deal with cycles
+      if (CurrentTier == T_Minimal &&
+          any_of(predecessors(B),
+                 [&](const BasicBlock *P) { return DT->dominates(B, P); }))
+        continue;
 
       // True if a Factor for this Expression with exactly the same arguments
       // exists. There are two possibilities for arguments equality, there
@@ -1645,11 +2541,34 @@ FactorInsertionRegular() {
 
 void SSAPRE::
 FactorInsertion() {
-  FactorInsertionMaterialized();
-  DEBUG(PrintDebug("STEP 1: F-Insertion.Materialized"));
+  if (CurrentTier == T_Full) {
+    FactorInsertionMaterialized();
+    DEBUG(PrintDebug("STEP 1: F-Insertion.Materialized"));
+  }
+
+  FactorInsertionRegular();
+  DEBUG(PrintDebug("STEP 1: F-Insertion.Regular"));
+
+  // Translating an Expression may simplify it, which is not safe to do from
+  // the concurrent part of the pass, so the translations are looked up here
+  for (auto B : JoinBlocks) {
+    for (auto F : BlockToFactors[B]) {
+      if (F->getIsMaterialized() || !HasPHIOperandsAt(F->getPExpr(), B))
+        continue;
+      for (auto P : F->getPreds())
+        PHITranslations[{F, P}] = GetPHITranslated(F, P);
+    }
+  }
+}
 
-  FactorInsertionRegular();
-  DEBUG(PrintDebug("STEP 1: F-Insertion.Regular"));
+// Pop every entry of the stack that was pushed outside of the dominator
+// subtree the occurrence with SDFS number belongs to. Once the walk leaves a
+// subtree it never comes back, so it does not matter when we pop those
+// entries as long as it is done before the top of the stack is used.
+static void
+BacktraceStack(ExprStack_t &VEStack, unsigned SDFS) {
+  while (!VEStack.empty() && VEStack.top().first > SDFS)
+    VEStack.pop();
 }
 
 void SSAPRE::
@@ -1674,7 +2593,7 @@ RenamePass() {
 
   // Init the stacks and counters
   for (auto &P : PExprToInsts) {
-    auto &PE = P.getFirst();
+    auto &PE = P.first;
     if (IgnoreExpression(PE)) continue;
 
     PExprToCounter.insert({PE, 0});
@@ -1715,16 +2634,20 @@ RenamePass() {
     for (auto FE : BlockToFactors[B]) {
       if (FE->getIsMaterialized()) continue;
       auto PE = FE->getPExpr();
+      auto &VEStack = PExprToVExprStack[PE];
+      BacktraceStack(VEStack, FSDFS);
       FE->setVersion(PExprToCounter[PE]++);
-      PExprToVExprStack[PE].push({FSDFS, FE});
+      VEStack.push({FSDFS, FE});
     }
 
     // Then materialized ones
     for (auto FE : BlockToFactors[B]) {
       if (!FE->getIsMaterialized()) continue;
       auto PE = FE->getPExpr();
+      auto &VEStack = PExprToVExprStack[PE];
+      BacktraceStack(VEStack, FSDFS);
       FE->setVersion(PExprToCounter[PE]++);
-      PExprToVExprStack[PE].push({FSDFS, FE});
+      VEStack.push({FSDFS, FE});
     }
 
     // And the rest of the instructions
@@ -1736,18 +2659,13 @@ RenamePass() {
       auto &PE = ExprToPExpr[VE];
       auto SDFS = InstrSDFS[&I];
 
-      // Backtrace every stacks if we jumped up the tree
-      for (auto &P : PExprToVExprStack) {
-        auto &VEStack = P.getSecond();
-        while (!VEStack.empty() && VEStack.top().first > SDFS) {
-          VEStack.pop();
-        }
-      }
-
       // Do nothing for ignored expressions
       if (IgnoreExpression(VE)) continue;
 
+      // Stacks are backtraced lazily, only the one of the current occurrence's
+      // class is brought up to date
       auto &VEStack = PExprToVExprStack[PE];
+      BacktraceStack(VEStack, SDFS);
       auto *VEStackTop = VEStack.empty() ? nullptr : VEStack.top().second;
       auto *VEStackTopF = VEStackTop
                             ? dyn_cast<FactorExpression>(VEStackTop)
@@ -1796,8 +2714,10 @@ RenamePass() {
       } else if (VEStackTopF) {
 
         // If every operands' definition dominates this Factor we are dealing
-        // with the same expression and assign Factor's version
-        if (OperandsDominate(VE, VEStackTopF)) {
+        // with the same expression and assign Factor's version. A load also
+        // requires the memory to stay intact since the Factor.
+        if (OperandsDominate(VE, VEStackTopF) &&
+            MemoryDominates(VE, VEStackTopF)) {
           VE->setVersion(VEStackTop->getVersion());
           AddSubstitution(VE, VEStackTop);
 
@@ -1847,6 +2767,10 @@ RenamePass() {
           }
         }
 
+        // Same goes for the memory state of a load
+        if (SameVersions && !MemoryDominates(VE, VEStackTop))
+          SameVersions = false;
+
         if (SameVersions) {
           VE->setVersion(VEStackTop->getVersion());
           AddSubstitution(VE, VEStackTop);
@@ -1857,22 +2781,53 @@ RenamePass() {
       }
 
       PExprToVersions[PE][VE->getVersion()].push_back(VE);
+      AddUsePositions(VersionUses[{PE, VE->getVersion()}], &I);
     }
 
     // For a terminator we need to visit every cfg successor of this block
     // to update its Factor expressions
     auto T = B->getTerminator();
+    auto TSDFS = InstrSDFS[T];
     for (auto S : T->successors()) {
       for (auto F : BlockToFactors[S]) {
         auto PE = F->getPExpr();
         auto &VEStack = PExprToVExprStack[PE];
+        BacktraceStack(VEStack, TSDFS);
         auto VEStackTop = VEStack.empty() ? nullptr : VEStack.top().second;
         auto VE = VEStack.empty() ? GetBottom() : VEStackTop;
 
         // Linked Factor's operands are already versioned and set
         if (F->getIsMaterialized()) {
           VE = F->getVExpr(B);
+
+        // The Expression's operands defined by PHIs of S are different at the
+        // end of B, the operand is the phi-translated Expression available
+        // there. A real occurrence only, a Factor of it would require
+        // propagating availability between the two Expression classes.
+        } else if (HasPHIOperandsAt(PE, S)) {
+          VEStackTop = nullptr;
+          VE = GetBottom();
+          if (auto TPE = PHITranslations.lookup({F, B})) {
+            auto &TStack = PExprToVExprStack[TPE];
+            BacktraceStack(TStack, TSDFS);
+            if (!TStack.empty() &&
+                !FactorExpression::classof(TStack.top().second)) {
+              VEStackTop = TStack.top().second;
+              VE = VEStackTop;
+            }
+          }
+          F->setVExpr(B, VE);
+
         } else {
+          // If the memory was clobbered since the top of the stack the operand
+          // is ⊥, for the top Factor this is the same as a new version without
+          // a real use of it
+          if (VEStackTop && !MemoryAvailableAtEnd(B, VEStackTop)) {
+            auto TF = dyn_cast<FactorExpression>(VEStackTop);
+            if (TF && !FactorHasRealUseBefore(TF, Path, InstToVExpr[T]))
+              TF->setDownSafe(false);
+            VE = GetBottom();
+          }
           F->setVExpr(B, VE);
         }
 
@@ -1894,20 +2849,81 @@ RenamePass() {
           }
         }
 
-        F->setHasRealUse(VE, HasRealUse);
+        F->setHasRealUse(B, HasRealUse);
+      }
+
+      // An occurrence of the Factor's own version at the end of B makes the
+      // Factor cycled. That holds only while its operands stay the same along
+      // the edge: an operand substituted by another Factor of S (a load that
+      // is the same as its Factor, for example) must be cycled as well, if
+      // the memory was clobbered on the way it is not and neither is this one.
+      //
+      // The Factor itself on top of the stack stands for its class
+      auto GetCycledVExpr = [&](FactorExpression *F) -> Expression * {
+        auto VE = F->getVExpr(B);
+        if (VE == F) return (Expression *)F->getPExpr();
+        if (!VE || FactorExpression::classof(VE) || IsBottomOrVarOrConst(VE) ||
+            ExprToPExpr.lookup(VE) != F->getPExpr() ||
+            VE->getVersion() != F->getVersion())
+          return nullptr;
+        return VE;
+      };
+
+      // Every cycled Factor is recorded with the Factors of S its operands are
+      // substituted by, the ones that are not cycled start the worklist
+      DenseMap<const FactorExpression *, FEVector_t> Dependents;
+      FEVector_t Worklist;
+      for (auto F : BlockToFactors[S]) {
+        if (F->getIsMaterialized()) continue;
+        auto VEBE = dyn_cast_or_null<BasicExpression>(GetCycledVExpr(F));
+        if (!VEBE) continue;
+
+        for (auto O : VEBE->getOperands()) {
+          auto OE = ValueToExp.lookup(O);
+          if (!OE || IsVariableOrConstant(OE)) continue;
+
+          auto OF = dyn_cast<FactorExpression>(GetSubstitution(OE));
+          if (!OF || FactorToBlock.lookup(OF) != S) continue;
+
+          if (GetCycledVExpr(OF)) {
+            Dependents[OF].push_back(F);
+          } else {
+            Worklist.push_back(F);
+            break;
+          }
+        }
+      }
+
+      while (!Worklist.empty()) {
+        auto F = Worklist.pop_back_val();
+        if (IsBottom(F->getVExpr(B))) continue;
+        F->setVExpr(B, GetBottom());
+        F->setHasRealUse(B, false);
+
+        auto DI = Dependents.find(F);
+        if (DI != Dependents.end())
+          Worklist.append(DI->second.begin(), DI->second.end());
       }
     }
 
     // STEP 3 Init: DownSafe
     // We set Factor's DownSafe to False if it is the last Expression's
-    // occurence before program exit.
+    // occurence before program exit. Only a Factor that dominates the exit can
+    // be on top of its stack, so instead of checking every stack we check
+    // classes of the Factors placed along the Path.
     if (T->getNumSuccessors() == 0) {
-      for (auto &P : PExprToVExprStack) {
-        auto &VEStack = P.getSecond();
-        if (VEStack.empty()) continue;
-        if (auto *F = dyn_cast<FactorExpression>(VEStack.top().second)) {
-          if (!FactorHasRealUseBefore(F, Path, InstToVExpr[T]))
-            F->setDownSafe(false);
+      SmallPtrSet<const Expression *, 8> Visited;
+      for (auto PB : Path) {
+        for (auto PF : BlockToFactors[PB]) {
+          auto PE = PF->getPExpr();
+          if (!Visited.insert(PE).second) continue;
+          auto &VEStack = PExprToVExprStack[PE];
+          BacktraceStack(VEStack, TSDFS);
+          if (VEStack.empty()) continue;
+          if (auto *F = dyn_cast<FactorExpression>(VEStack.top().second)) {
+            if (!FactorHasRealUseBefore(F, Path, InstToVExpr[T]))
+              F->setDownSafe(false);
+          }
         }
       }
     }
@@ -1917,6 +2933,7 @@ RenamePass() {
 void SSAPRE::
 RenameCleaup() {
   SmallPtrSet<FactorExpression *, 32> FactorKillList;
+  DenseMap<const FactorExpression *, const PHINode *> KilledFor;
 
   // We are interested only in comparing the non-materialized Factors and any
   // PHIs. The key idea here is that if a PHI is to have a Factor it would have
@@ -1928,6 +2945,12 @@ RenameCleaup() {
   TokenPropagationSolver TokSolver(TPST_Approximation, *this);
   TokSolver.Solve();
   for (auto B : JoinBlocks) {
+    // The profile-guided cut relies on DownSafety, in that mode the loose
+    // match below is left to cycle headers
+    bool Loose = !BFI || any_of(predecessors(B), [&](const BasicBlock *P) {
+      return DT->dominates(B, P);
+    });
+
     for (auto F : BlockToFactors[B]) {
       if (F->getIsMaterialized()) continue;
 
@@ -1954,11 +2977,23 @@ RenameCleaup() {
           // Kinda a special case, while assigning versioned expressions to a
           // Factor we cannot infer that a variable or a constant is coming
           // from the predecessor and we assign it to ⊥, but a Linked Factor
-          // will know for sure whether a constant/variable is involved.
-          if ((IsVariableOrConstant(PV) || PHINode::classof(PV)) &&
+          // will know for sure whether a constant/variable is involved. At
+          // an exit such a PHI may merely mimic the Factor, and killing the
+          // Factor loses its DownSafety.
+          if (Loose && (IsVariableOrConstant(PV) || PHINode::classof(PV)) &&
               (IsBottom(FVE) || FactorExpression::classof(FVE)))
             continue;
 
+          // With a profile a PHI operand matches only the Factor it stands for
+          if (auto PVPHI = BFI ? dyn_cast<PHINode>(PV) : nullptr) {
+            auto G = dyn_cast_or_null<FactorExpression>(FVE);
+            if (G && (FactorToPHI.lookup(G) == PVPHI ||
+                      KilledFor.lookup(G) == PVPHI))
+              continue;
+            Skip = true;
+            break;
+          }
+
           // Continuing from the previous check, if one the operands is a const
           // variable or bottom we skip further comparing because it is clearly
           // a mismatch
@@ -1985,6 +3020,7 @@ RenameCleaup() {
         if (Skip) continue;
         if (Kill) {
           FactorKillList.insert(F);
+          KilledFor[F] = PHI;
           break;
         }
       }
@@ -1992,7 +3028,6 @@ RenameCleaup() {
   }
 
   for (auto F : FactorKillList) {
-    if (auto P = F->getProto()) P->dropAllReferences();
     KillFactor(F);
     AddSubstitution(F, GetTop());
   }
@@ -2021,7 +3056,9 @@ RenameInductivityPass() {
   for (auto F : FExprs) {
 
     if (FactorKillList.count(F)) continue;
-    for (auto VE : F->getVExprs()) {
+    auto VEs = F->getVExprs();
+    for (size_t i = 0, l = VEs.size(); i < l; ++i) {
+      auto VE = VEs[i];
 
       // Factors with related induction operands are useless, we cannot move
       // them or change, so just kill'em.
@@ -2054,9 +3091,11 @@ RenameInductivityPass() {
       }
 
       // This happens if the Factor is contained inside a cycle and there is
-      // not change in the expression's operands along this cycle.
-      if (F->getVersion() == VE->getVersion()) {
-        F->setIsCycle(VE, true);
+      // not change in the expression's operands along this cycle. Versions
+      // are per class, a phi-translated operand belongs to another one.
+      if (ExprToPExpr[VE] == F->getPExpr() &&
+          F->getVersion() == VE->getVersion()) {
+        F->setIsCycleAt(i, true);
       }
     }
   }
@@ -2084,9 +3123,6 @@ RenameInductivityPass() {
 
   // Remove all stuff related
   for (auto F : FactorKillList) {
-
-    if (auto P = F->getProto()) P->dropAllReferences();
-
     auto PHI = FactorToPHI[F];
     auto REP = PHI ? InstToVExpr[PHI] : GetTop();
     KillFactor(F);
@@ -2098,10 +3134,18 @@ void SSAPRE::
 Rename() {
   RenamePass();
   DEBUG(PrintDebug("Rename.Pass"));
-  RenameCleaup();
-  DEBUG(PrintDebug("Rename.Cleanup"));
-  RenameInductivityPass();
-  DEBUG(PrintDebug("Rename.InductivityPass"));
+
+  // Without materialized Factors there is nothing to compare PHIs with
+  if (CurrentTier == T_Full) {
+    RenameCleaup();
+    DEBUG(PrintDebug("Rename.Cleanup"));
+  }
+
+  // Without Factors at cycle headers there are no inductions
+  if (CurrentTier != T_Minimal) {
+    RenameInductivityPass();
+    DEBUG(PrintDebug("Rename.InductivityPass"));
+  }
 }
 
 bool SSAPRE::
@@ -2134,63 +3178,253 @@ IsInductionExpression(const FactorExpression *F, const Expression *E) {
   return false;
 }
 
-void SSAPRE::
-ResetDownSafety(FactorExpression *FE, Expression *E) {
-  if (FE->getHasRealUse(E) || !FactorExpression::classof(E)) {
-    return;
+bool SSAPRE::
+IsCycleInvariant(const Value *V, const BasicBlock *H) {
+  if (isa<Constant>(V) || isa<Argument>(V)) return true;
+  if (auto I = dyn_cast<Instruction>(V))
+    return !DT->dominates(H, I->getParent());
+  return false;
+}
+
+Value * SSAPRE::
+GetInductionStep(PHINode *PHI, Value *V) {
+  auto I = dyn_cast<BinaryOperator>(V);
+  if (!I || I->getOpcode() != Instruction::Add) return nullptr;
+  auto H = PHI->getParent();
+  if (I->getOperand(0) == PHI && IsCycleInvariant(I->getOperand(1), H))
+    return I->getOperand(1);
+  if (I->getOperand(1) == PHI && IsCycleInvariant(I->getOperand(0), H))
+    return I->getOperand(0);
+  return nullptr;
+}
+
+bool SSAPRE::
+StrengthReduction() {
+  bool Changed = false;
+
+  for (auto &H : *Func) {
+    if (!DT->isReachableFromEntry(&H)) continue;
+
+    // A cycle header is entered from outside and from its back branches
+    SmallVector<BasicBlock *, 4> Latches;
+    bool HasEntry = false;
+    for (auto P : predecessors(&H)) {
+      if (DT->dominates(&H, P))
+        Latches.push_back(P);
+      else
+        HasEntry = true;
+    }
+    if (Latches.empty() || !HasEntry) continue;
+
+    // The cycle consists of the blocks that reach a back branch, a block that
+    // only leaves the cycle executes its computations once
+    SmallPtrSet<const BasicBlock *, 16> Cycle;
+    Cycle.insert(&H);
+    while (!Latches.empty()) {
+      auto B = Latches.pop_back_val();
+      if (!Cycle.insert(B).second) continue;
+      for (auto P : predecessors(B))
+        if (DT->dominates(&H, P)) Latches.push_back(P);
+    }
+
+    // Loop-invariant computations are placed at the end of the immediate
+    // dominator, it lies outside of the cycle and every invariant operand is
+    // available there
+    auto Pre = DT->getNode(&H)->getIDom()->getBlock();
+
+    SmallVector<PHINode *, 4> PHIs;
+    for (auto &I : H) {
+      auto PHI = dyn_cast<PHINode>(&I);
+      if (!PHI) break;
+      if (PHI->getType()->isIntegerTy()) PHIs.push_back(PHI);
+    }
+
+    for (auto PHI : PHIs) {
+      // i = phi(i0, i + s) with invariant s on every back branch
+      bool Additive = true;
+      for (unsigned i = 0, l = PHI->getNumIncomingValues(); i < l; ++i) {
+        if (DT->dominates(&H, PHI->getIncomingBlock(i)) &&
+            !GetInductionStep(PHI, PHI->getIncomingValue(i))) {
+          Additive = false;
+          break;
+        }
+      }
+      if (!Additive) continue;
+
+      // Injured multiplicative expressions i * c, grouped by c
+      MapVector<Value *, SmallVector<Instruction *, 2>> Muls;
+      for (auto U : PHI->users()) {
+        auto M = dyn_cast<BinaryOperator>(U);
+        if (!M || M->getOpcode() != Instruction::Mul) continue;
+        if (!Cycle.count(M->getParent())) continue;
+        auto C = M->getOperand(0) == PHI ? M->getOperand(1)
+                                         : M->getOperand(0);
+        if (C == PHI || !IsCycleInvariant(C, &H)) continue;
+        Muls[C].push_back(M);
+      }
+
+      for (auto &MP : Muls) {
+        auto C = MP.first;
+        auto Ty = PHI->getType();
+
+        // The repaired value is carried by a new PHI: i0 * c on entry and
+        // the previous value plus s * c on every back branch
+        auto NPHI = PHINode::Create(Ty, PHI->getNumIncomingValues(),
+                                    PHI->getName() + ".sr", &H.front());
+        DenseMap<std::pair<Value *, BasicBlock *>, Value *> MulCache;
+        auto Mul = [&](Value *A, BasicBlock *B) -> Value * {
+          if (auto V = SimplifyMulInst(A, C, *DL, TLI, DT, AC))
+            return V;
+          auto &V = MulCache[{A, B}];
+          if (!V) V = BinaryOperator::CreateMul(A, C, "", B->getTerminator());
+          return V;
+        };
+        DenseMap<Value *, Value *> IncCache;
+
+        for (unsigned i = 0, l = PHI->getNumIncomingValues(); i < l; ++i) {
+          auto B = PHI->getIncomingBlock(i);
+          auto V = PHI->getIncomingValue(i);
+          if (!DT->dominates(&H, B)) {
+            NPHI->addIncoming(Mul(V, B), B);
+            continue;
+          }
+
+          auto Inc = cast<Instruction>(V);
+          auto &NInc = IncCache[Inc];
+          if (!NInc) {
+            auto Step = Mul(GetInductionStep(PHI, Inc), Pre);
+            NInc = BinaryOperator::CreateAdd(NPHI, Step, Inc->getName() + ".sr");
+            cast<Instruction>(NInc)->insertAfter(Inc);
+          }
+          NPHI->addIncoming(NInc, B);
+        }
+
+        for (auto M : MP.second) {
+          M->replaceAllUsesWith(NPHI);
+          M->eraseFromParent();
+          Stats.StrengthReduced++;
+        }
+        Changed = true;
+      }
+    }
   }
 
-  auto F = (FactorExpression *)E;
-  if (!F->getDownSafe())
-    return;
+  return Changed;
+}
 
-  F->setDownSafe(false);
-  for (auto VE : F->getVExprs()) {
-    ResetDownSafety(F, VE);
+void SSAPRE::
+BuildFactorGraph() {
+  // For every Factor that is used as an operand of another Factor we record
+  // all the places it is used at, this way the propagation steps below visit
+  // only the affected Factors instead of rescanning all of them.
+  for (auto F : FExprs) {
+    auto VEs = F->getVExprs();
+    for (size_t i = 0, l = VEs.size(); i < l; ++i) {
+      if (auto G = dyn_cast_or_null<FactorExpression>(VEs[i]))
+        FactorUses[G].push_back({F, i});
+    }
   }
 }
 
+bool SSAPRE::
+IsSpeculationCandidate(const FactorExpression *F) {
+  if (F->getIsMaterialized()) return false;
+
+  // Only a cycle header, i.e. a block that dominates one of its predecessors
+  auto B = F->getBB();
+  if (none_of(F->getPreds(),
+              [&](const BasicBlock *P) { return DT->dominates(B, P); }))
+    return false;
+
+  auto I = F->getPExpr()->getProto();
+  return isSafeToSpeculativelyExecute(I) &&
+         TTI->getUserCost(I) <= (int)SSAPRESpeculationThreshold;
+}
+
 void SSAPRE::
 DownSafety() {
+  // A cheap computation that cannot fault is assumed anticipated at a cycle
+  // header, this lets the cycle handling of the bottom-up walk hoist it. Such
+  // a Factor keeps its DownSafe flag during the propagation and does not pass
+  // its loss further up, it is Speculative only if it would have lost it.
+  SmallPtrSet<const FactorExpression *, 8> Candidates;
+  if (SSAPRESpeculate && CurrentTier == T_Full) {
+    for (auto F : FExprs) {
+      if (IsSpeculationCandidate(F)) Candidates.insert(F);
+    }
+  }
+
   // Here we propagate DownSafety flag initialized during Step 2 up the Factor
   // graph for each expression
+  FEVector_t Worklist;
   for (auto F : FExprs) {
     if (F->getDownSafe()) continue;
-    for (auto VE : F->getVExprs()) {
-      ResetDownSafety(F, VE);
+    if (Candidates.count(F)) {
+      F->setDownSafe(true);
+      F->setSpeculative(true);
+    } else {
+      Worklist.push_back(F);
+    }
+  }
+
+  while (!Worklist.empty()) {
+    auto F = Worklist.pop_back_val();
+    auto VEs = F->getVExprs();
+    for (size_t i = 0, l = VEs.size(); i < l; ++i) {
+      Stats.PropagationSteps++;
+      if (F->getHasRealUseAt(i)) continue;
+
+      auto G = dyn_cast_or_null<FactorExpression>(VEs[i]);
+      if (!G || !G->getDownSafe() || G->getSpeculative()) continue;
+
+      if (Candidates.count(G)) {
+        G->setSpeculative(true);
+        continue;
+      }
+
+      G->setDownSafe(false);
+      Worklist.push_back(G);
     }
   }
 }
 
 void SSAPRE::
 ComputeCanBeAvail() {
+  FEVector_t Worklist;
   for (auto F : FExprs) {
     if (!F->getDownSafe() && F->getCanBeAvail()) {
       for (auto V : F->getVExprs()) {
         if (IsBottom(V)) {
-          ResetCanBeAvail(F);
+          F->setCanBeAvail(false);
+          Worklist.push_back(F);
           break;
         }
       }
     }
   }
+
+  ResetCanBeAvail(Worklist);
 }
 
 void SSAPRE::
-ResetCanBeAvail(FactorExpression *G) {
-  G->setCanBeAvail(false);
-  for (auto F : FExprs) {
-    if (F->hasVExpr(G) && !F->getHasRealUse(G)) {
+ResetCanBeAvail(FEVector_t &Worklist) {
+  while (!Worklist.empty()) {
+    auto G = Worklist.pop_back_val();
+    for (auto &U : FactorUses[G]) {
+      auto F = U.first;
+      auto i = U.second;
+      Stats.PropagationSteps++;
 
-      // If it happens to be a cycle clear the flag
-      if (F->getIsCycle(G)) {
-        F->setIsCycle(G, false);
-      }
+      // The operand might have been replaced already
+      if (F->getVExprAt(i) != G || F->getHasRealUseAt(i)) continue;
 
-      F->replaceVExpr(G, GetBottom());
+      // If it happens to be a cycle clear the flag
+      F->setIsCycleAt(i, false);
+      F->setVExprAt(i, GetBottom());
 
       if (!F->getDownSafe() && F->getCanBeAvail()) {
-        ResetCanBeAvail(F);
+        F->setCanBeAvail(false);
+        Worklist.push_back(F);
       }
     }
   }
@@ -2198,33 +3432,281 @@ ResetCanBeAvail(FactorExpression *G) {
 
 void SSAPRE::
 ComputeLater() {
+  FEVector_t Worklist;
   for (auto F : FExprs) {
     F->setLater(F->getCanBeAvail());
   }
   for (auto F : FExprs) {
     if (F->getLater()) {
-      for (auto VE : F->getVExprs()) {
-        if ((F->getHasRealUse(VE) || F->getIsCycle(VE)) && !IsBottom(VE)) {
-          ResetLater(F);
+      auto VEs = F->getVExprs();
+      for (size_t i = 0, l = VEs.size(); i < l; ++i) {
+        if ((F->getHasRealUseAt(i) || F->getIsCycleAt(i)) &&
+            !IsBottom(VEs[i])) {
+          F->setLater(false);
+          Worklist.push_back(F);
           break;
         }
       }
     }
   }
+
+  while (!Worklist.empty()) {
+    auto G = Worklist.pop_back_val();
+    for (auto &U : FactorUses[G]) {
+      auto F = U.first;
+      Stats.PropagationSteps++;
+      if (F->getVExprAt(U.second) != G || !F->getLater()) continue;
+      F->setLater(false);
+      Worklist.push_back(F);
+    }
+  }
+}
+
+uint64_t SSAPRE::
+GetFrequency(const BasicBlock *B) {
+  assert(BFI);
+  return BFI->getBlockFreq(B).getFrequency();
 }
 
 void SSAPRE::
-ResetLater(FactorExpression *G) {
-  G->setLater(false);
-  for (auto F : FExprs) {
-    if (F->hasVExpr(G) && F->getLater()) ResetLater(F);
+ComputeMinCut() {
+  using namespace min_cut;
+
+  // Cycled Factors are hoisted separately and materialized ones are already
+  // PHIs, both are treated as available operands here
+  MapVector<const Expression *, SmallVector<FactorExpression *, 8>> PExprToFs;
+  for (auto B : JoinBlocks) {
+    for (auto F : BlockToFactors[B]) {
+      if (!F->getAnyCycles() && !F->getIsMaterialized())
+        PExprToFs[F->getPExpr()].push_back(F);
+    }
+  }
+
+  for (auto &P : PExprToFs) {
+    auto PE = P.first;
+    auto &Fs = P.second;
+
+    DenseMap<const FactorExpression *, unsigned> FactorToIndex;
+    for (unsigned i = 0, l = Fs.size(); i < l; ++i) FactorToIndex[Fs[i]] = i;
+
+    MinCutSolver S(Fs.size());
+    for (unsigned i = 0, l = Fs.size(); i < l; ++i) {
+      auto F = Fs[i];
+      auto N = MinCutSolver::getNode(i);
+      bool CanInsert = OperandsDominate(PE->getProto(), F);
+
+      // Every unavailable operand is a source edge whose cut is an insertion
+      // at the end of the predecessor
+      auto Preds = F->getPreds();
+      for (size_t j = 0, k = Preds.size(); j < k; ++j) {
+        if (F->getHasRealUseAt(j)) continue;
+        auto O = F->getVExprAt(j);
+        auto PB = Preds[j];
+        auto Cap = CanInsert && IsSafeToInsert(PE, F, PB)
+                     ? GetFrequency(PB) : MinCutSolver::Infinity;
+        if (!O || IsBottom(O)) {
+          S.addEdge(MinCutSolver::Source, N, Cap);
+        } else if (auto G = dyn_cast<FactorExpression>(O)) {
+          if (FactorToIndex.count(G))
+            S.addEdge(MinCutSolver::getNode(FactorToIndex[G]), N, Cap);
+        }
+      }
+
+      // Every occurrence that is not redundant to another real one is a sink
+      // edge whose cut leaves the computation in place. Each costs at least
+      // one so that a full redundancy is always removed.
+      uint64_t Cost = 0;
+      auto &VEs = GetSameVExpr(F);
+      for (auto VE : VEs) {
+        if (any_of(VEs, [&](Expression *D) {
+              return StrictlyDominates(D, VE);
+            }))
+          continue;
+        auto B = VExprToInst[VE]->getParent();
+        Cost = SaturatingAdd(Cost, std::max(GetFrequency(B), (uint64_t)1));
+      }
+      S.addEdge(N, MinCutSolver::Sink, Cost);
+    }
+
+    Stats.AugmentingPaths += S.Solve();
+
+    for (unsigned i = 0, l = Fs.size(); i < l; ++i) {
+      auto F = Fs[i];
+      bool Avail = S.getIsSinkSide(i);
+      F->setLater(!Avail);
+      if (Avail) {
+        // Insertions into a Factor that is not DownSafe were checked for
+        // speculation safety above
+        if (!F->getDownSafe()) F->setSpeculative(true);
+        F->setDownSafe(true);
+        F->setCanBeAvail(true);
+      }
+    }
+  }
+}
+
+bool SSAPRE::
+IsProfitableCycleHoist(FactorExpression *F, const BasicBlock *PB) {
+  uint64_t Cost = 0;
+  for (auto VE : GetSameVExpr(F)) {
+    auto B = VExprToInst[VE]->getParent();
+    Cost = SaturatingAdd(Cost, GetFrequency(B));
   }
+  return GetFrequency(PB) < Cost;
 }
 
 void SSAPRE::
 WillBeAvail() {
   ComputeCanBeAvail();
   ComputeLater();
+  if (BFI && CurrentTier == T_Full) ComputeMinCut();
+  if (SSAPRERegisterPressure) {
+    ComputeRegisterPressure();
+    ComputePressureAvail();
+  }
+}
+
+SSAPRE::RegisterClass SSAPRE::
+GetRegisterClass(Type *T) const {
+  // Floating point values share the vector registers on the targets we care
+  // about, unless there are none
+  if ((T->isVectorTy() || T->isFloatingPointTy()) && RegisterLimit[RC_Vector])
+    return RC_Vector;
+  return RC_Scalar;
+}
+
+void SSAPRE::
+ComputeLiveIn(const Value *V, const BasicBlock *DefB, BBSet_t &LiveIn) {
+  SmallVector<const BasicBlock *, 16> Worklist;
+  for (auto &U : V->uses()) {
+    auto UI = cast<Instruction>(U.getUser());
+    auto UB = UI->getParent();
+    // A PHI uses its operand at the end of the incoming block
+    if (auto PHI = dyn_cast<PHINode>(UI))
+      UB = PHI->getIncomingBlock(U);
+    Worklist.push_back(UB);
+  }
+
+  while (!Worklist.empty()) {
+    auto B = Worklist.pop_back_val();
+    if (B == DefB || !DT->isReachableFromEntry(B)) continue;
+    if (!LiveIn.insert(B).second) continue;
+    Worklist.append(pred_begin(B), pred_end(B));
+  }
+}
+
+void SSAPRE::
+ComputeRegisterPressure() {
+  RegisterLimit[RC_Scalar] = TTI->getNumberOfRegisters(false);
+  RegisterLimit[RC_Vector] = TTI->getNumberOfRegisters(true);
+
+  for (auto &B : *Func) BlockPressure[&B].fill(0);
+
+  auto Count = [&](const Value *V, const BasicBlock *DefB) {
+    if (V->getType()->isVoidTy() || V->use_empty()) return;
+    auto RC = GetRegisterClass(V->getType());
+    BBSet_t LiveIn;
+    ComputeLiveIn(V, DefB, LiveIn);
+    for (auto B : LiveIn) BlockPressure[B][RC]++;
+  };
+
+  auto &Entry = Func->getEntryBlock();
+  for (auto &A : Func->args()) Count(&A, &Entry);
+  for (auto &B : *Func)
+    for (auto &I : B) Count(&I, &B);
+}
+
+BBSet_t &SSAPRE::
+GetLiveIn(const Instruction *I) {
+  auto LI = ValueToLiveIn.find(I);
+  if (LI != ValueToLiveIn.end()) return LI->second;
+  auto &LiveIn = ValueToLiveIn[I];
+  ComputeLiveIn(I, I->getParent(), LiveIn);
+  return LiveIn;
+}
+
+bool SSAPRE::
+ExtendLiveRange(Type *T, const BasicBlock *DefB,
+                ArrayRef<const BasicBlock *> UseBs, BBSet_t &LiveIn,
+                const Instruction *R) {
+  if (BlockPressure.empty()) return true;
+
+  // Blocks the value is not live into yet, in the order they are reached from
+  // the uses so the reported block does not depend on pointer values
+  SmallSetVector<const BasicBlock *, 8> NewLiveIn;
+  SmallVector<const BasicBlock *, 16> Worklist(UseBs.begin(), UseBs.end());
+  while (!Worklist.empty()) {
+    auto B = Worklist.pop_back_val();
+    if (B == DefB || LiveIn.count(B) || !DT->isReachableFromEntry(B)) continue;
+    if (!NewLiveIn.insert(B)) continue;
+    Worklist.append(pred_begin(B), pred_end(B));
+  }
+
+  auto RC = GetRegisterClass(T);
+  for (auto B : NewLiveIn) {
+    if (BlockPressure[B][RC] < RegisterLimit[RC]) continue;
+
+    // The diagnostic handler belongs to the LLVMContext, concurrent runs take
+    // turns
+    std::unique_lock<std::mutex> Lock;
+    if (ContextLock) Lock = std::unique_lock<std::mutex>(*ContextLock);
+    ORE->emit(OptimizationRemarkMissed(DEBUG_TYPE, "RegisterPressure", R)
+              << "redundancy is not eliminated, it would raise register "
+                 "pressure in "
+              << B->getName() << " above "
+              << ore::NV("Limit", RegisterLimit[RC]));
+    return false;
+  }
+
+  for (auto B : NewLiveIn) {
+    BlockPressure[B][RC]++;
+    LiveIn.insert(B);
+  }
+
+  if (!NewLiveIn.empty()) {
+    std::unique_lock<std::mutex> Lock;
+    if (ContextLock) Lock = std::unique_lock<std::mutex>(*ContextLock);
+    ORE->emit(OptimizationRemark(DEBUG_TYPE, "RegisterPressure",
+                                 R->getDebugLoc(), R->getParent())
+              << "redundancy is eliminated, the value is kept live into "
+              << ore::NV("Blocks", (unsigned)NewLiveIn.size())
+              << " more blocks within " << ore::NV("Limit", RegisterLimit[RC])
+              << " registers");
+  }
+  return true;
+}
+
+void SSAPRE::
+ComputePressureAvail() {
+  // A new PHI is live from its block to the occurrences it replaces, if it
+  // does not fit the Factor is not available in any way. Cycled Factors are
+  // checked when hoisted.
+  FEVector_t Worklist;
+  auto DFI = df_begin(DT->getRootNode());
+  for (auto DFE = df_end(DT->getRootNode()); DFI != DFE; ++DFI) {
+    auto B = DFI->getBlock();
+    for (auto F : BlockToFactors[B]) {
+      if (!F->getWillBeAvail() || F->getAnyCycles() || F->getIsMaterialized())
+        continue;
+
+      SmallVector<const BasicBlock *, 8> UseBs;
+      const Instruction *R = nullptr;
+      for (auto VE : GetSameVExpr(F)) {
+        auto I = VExprToInst[VE];
+        UseBs.push_back(I->getParent());
+        if (!R) R = I;
+      }
+
+      BBSet_t LiveIn;
+      if (!R || ExtendLiveRange(R->getType(), B, UseBs, LiveIn, R)) continue;
+
+      // The Factors that rely on this one being available are updated right
+      // away so that they are not charged for below
+      F->setCanBeAvail(false);
+      Worklist.push_back(F);
+      ResetCanBeAvail(Worklist);
+    }
+  }
 }
 
 void SSAPRE::
@@ -2233,7 +3715,7 @@ Finalize() {
 
   // Init available definitons map
   for (auto &P : PExprToInsts) {
-    AvailDef.insert({P.getFirst(), DenseMap<int,Expression *>()});
+    AvailDef.insert({P.first, DenseMap<int,Expression *>()});
   }
 
   // NOTE Using DT walk here is not really necessary because this loop does not
@@ -2244,6 +3726,7 @@ Finalize() {
 
     for (auto F : BlockToFactors[B]) {
       auto V = F->getVersion();
+
       if (F->getWillBeAvail() || F->getAnyCycles() || F->getIsMaterialized()) {
         auto PE = F->getPExpr();
         AvailDef[PE][V] = F;
@@ -2270,6 +3753,11 @@ Finalize() {
       // in rename since cycled operands considered available.
 
       AddSubstitution(VE, VE);
+
+      // A load is kept even if its result is not used, it goes away only if it
+      // is redundant
+      if (LoadExpression::classof(VE)) VE->addSave();
+
       if (auto PHI = dyn_cast<PHINode>(&I)) {
         if (PHI->getNumOperands() == 1) {
           auto PHIO = PHI->getIncomingValue(0);
@@ -2289,6 +3777,13 @@ Finalize() {
       if (!DEF || IsBottomOrVarOrConst(DEF) || !NotStrictlyDominates(DEF, VE)) {
         ADPE[V] = VE;
 
+        // Reusing an earlier real occurrence extends its live range to this
+        // one, if it does not fit this occurrence becomes the new definition
+      } else if (!BlockPressure.empty() && !FactorExpression::classof(DEF) &&
+                 !ExtendLiveRange(I.getType(), VExprToInst[DEF]->getParent(),
+                                  {B}, GetLiveIn(VExprToInst[DEF]), &I)) {
+        ADPE[V] = VE;
+
         // Otherwise, it is the same expression of the same version, and we just
         // add the substitution
       } else {
@@ -2305,8 +3800,10 @@ FactorCleanup(FactorExpression * F) {
   Expression * O = nullptr;
   bool Same = true;
   bool HRU = false;
-  for (auto P : F->getVExprs()) {
-    HRU |= F->getHasRealUse(P);
+  auto VEs = F->getVExprs();
+  for (size_t i = 0, l = VEs.size(); i < l; ++i) {
+    auto P = VEs[i];
+    HRU |= F->getHasRealUseAt(i);
     auto PS = GetSubstitution(P);
     if (O && O != PS) {
       Same = false;
@@ -2403,8 +3900,8 @@ FactorGraphWalkBottomUp() {
         for (auto P : FE->getPreds()) {
           auto V = FE->getVExpr(P);
 
-          if (FE->getIsCycle(V)) {
-            CycledHRU |= FE->getHasRealUse(V);
+          if (FE->getIsCycle(P)) {
+            CycledHRU |= FE->getHasRealUse(P);
             CEV.push_back(V);
             continue;
           }
@@ -2450,27 +3947,60 @@ FactorGraphWalkBottomUp() {
           continue; // no further processing
         }
 
+        // With a profile a speculative hoist must pay off, otherwise the cycled
+        // expressions stay where they are
+        if (BFI && !FE->getDownSafe() && !IsProfitableCycleHoist(FE, PB)) {
+          for (auto CE : CEV)  AddSubstitution(CE, CE, /* direct */ true);
+          continue; // no further processing
+        }
+
         // TODO If there is no use of the expression inside the cycle move it
         // TODO to its successors
         auto T = PB->getTerminator();
 
         // Make sure the operands available at the predecessor block end
         if (!OperandsDominateStrictly(PE->getProto(), InstToVExpr[T])) continue;
+        if (!IsSafeToInsert(PE, FE, PB)) continue;
+
+        // The hoisted value is live throughout the cycle
+        if (!BlockPressure.empty()) {
+          SmallVector<const BasicBlock *, 8> UseBs;
+          const Instruction *R = nullptr;
+          for (auto V : GetSameVExpr(FE)) {
+            auto I = VExprToInst[V];
+            UseBs.push_back(I->getParent());
+            if (!R) R = I;
+          }
+
+          BBSet_t LiveIn;
+          if (R && !ExtendLiveRange(R->getType(), PB, UseBs, LiveIn, R)) {
+            for (auto CE : CEV)  AddSubstitution(CE, CE, /* direct */ true);
+            continue; // no further processing
+          }
+        }
 
         // At this point we only the only concern is whether the non-cycled
         // expression exist or not. Even if it is a variable or a const it is
         // not used due to the guard above
-        bool HRU = FE->getHasRealUse(VE);
+        bool HRU = FE->getHasRealUse(PB);
         if (IsBottomOrVarOrConst(VE)) {
-          auto I = PE->getProto()->clone();
+          auto IB = GetInsertionBlock(FE, PB);
+          auto I = CloneProto(PE);
           VE = CreateExpression(*I);
-          AddExpression(PE, VE, I, PB);
-          auto T = PB->getTerminator();
+          AddExpression(PE, VE, I, IB);
+          auto T = IB->getTerminator();
           SetOrderBefore(I, T);
           SetAllOperandsSave(I);
           I->insertBefore(T);
-          SSAPREInstrInserted++;
+          InsertMemoryAccess(I, MemorySSA::End);
+          Stats.InstrInserted++;
           HRU = false;
+
+          ORE->emit(OptimizationRemark(DEBUG_TYPE, "Hoisted", I)
+                    << ore::NV("Instruction", I)
+                    << " hoisted out of the cycle headed by "
+                    << B->getName() << " into "
+                    << IB->getName());
         }
 
         Changed = ReplaceFactor(FE, VE, HRU, /* direct */ true);
@@ -2491,22 +4021,33 @@ FactorGraphWalkBottomUp() {
                 IsBottom(O) ||
 
                 // HRU(O) is False and O is Factor and WBA(O) is False
-                (!FE->getHasRealUse(O) && FactorExpression::classof(O) &&
+                (!FE->getHasRealUse(BB) && FactorExpression::classof(O) &&
                  !dyn_cast<FactorExpression>(O)->getWillBeAvail())) {
 
               auto PR = PE->getProto();
               if (!OperandsDominate(PR, FE)) break;
+              if (!IsSafeToInsert(PE, FE, BB)) break;
 
-              auto I = PR->clone();
+              // Translate before the edge is split, the PHIs of B refer to
+              // the new block afterwards
+              auto I = CloneProto(PE, B, BB);
+              auto IB = GetInsertionBlock(FE, BB);
               auto VE = CreateExpression(*I);
-              FE->setVExpr(BB, VE);
-              AddExpression(PE, VE, I, BB);
+              FE->setVExpr(IB, VE);
+              AddExpression(PE, VE, I, IB);
 
-              auto T = BB->getTerminator();
+              auto T = IB->getTerminator();
               SetOrderBefore(I, T);
               SetAllOperandsSave(I);
               I->insertBefore(T);
-              SSAPREInstrInserted++;
+              InsertMemoryAccess(I, MemorySSA::End);
+              Stats.InstrInserted++;
+
+              ORE->emit(OptimizationRemark(DEBUG_TYPE, "Inserted", I)
+                        << ore::NV("Instruction", I) << " inserted in "
+                        << IB->getName()
+                        << " to make it fully redundant in "
+                        << B->getName());
             }
           }
 
@@ -2518,14 +4059,20 @@ FactorGraphWalkBottomUp() {
             // Make sure this new instruction's operands will dominate this PHI
             OperandsDominate(PE->getProto(), FE)) {
 
-          auto I = PE->getProto()->clone();
+          auto I = CloneProto(PE);
           auto VE = CreateExpression(*I);
           AddExpression(PE, VE, I, B);
           auto T = B->getFirstNonPHI();
           SetOrderBefore(I, T);
           SetAllOperandsSave(I);
           I->insertBefore((Instruction *)T);
-          SSAPREInstrInserted++;
+          InsertMemoryAccess(I, MemorySSA::Beginning);
+          Stats.InstrInserted++;
+
+          ORE->emit(OptimizationRemark(DEBUG_TYPE, "Inserted", I)
+                    << ore::NV("Instruction", I) << " inserted in "
+                    << B->getName()
+                    << " in place of a useless PHI");
 
           ReplaceFactor(FE, VE, /* HRU */ false);
           Changed = true;
@@ -2576,7 +4123,7 @@ PHIInsertion() {
       auto PHI = Builder.CreatePHI(TY, F->getTotalPredecessors());
       PHI->setName("ssapre_phi");
 
-      SSAPREPHIInserted++;
+      Stats.PHIInserted++;
 
       // Fill-in PHI operands
       for (auto P : F->getPreds()) {
@@ -2620,6 +4167,10 @@ bool SSAPRE::
 ApplySubstitutions() {
   bool Changed = false;
 
+  // Instruction and its replacement, reported in program order once all of
+  // them are known
+  SmallVector<std::pair<Instruction *, Value *>, 32> Eliminated;
+
   for (auto P : VExprToInst) {
     if (!P.getFirst() || !P.getSecond()) {
       // llvm_unreachable("Why is this happening?");
@@ -2640,8 +4191,9 @@ ApplySubstitutions() {
 
       auto VI = VExprToInst[VE];
       VI->replaceAllUsesWith(T);
-      SSAPREInstrSubstituted++;
-      KillList.push_back(VI);
+      Stats.InstrSubstituted++;
+      Eliminated.push_back({VI, T});
+      AddToKillList(VI);
       continue;
     }
 
@@ -2655,7 +4207,7 @@ ApplySubstitutions() {
     // Top value forces this instruction to stay as is if there are uses
     if (IsTop(SE)) {
       // No uses? GTFO
-      if (!VI->getNumUses()) KillList.push_back(VI);
+      if (!VI->getNumUses()) AddToKillList(VI);
       continue;
     }
 
@@ -2665,7 +4217,7 @@ ApplySubstitutions() {
       // is when its Factor is deleted because of uselessness
       if (!FactorExpression::classof(VE) && !VE->getSave()) {
         assert(AllUsersKilled(VI));
-        KillList.push_back(VI);
+        AddToKillList(VI);
       }
       continue;
     }
@@ -2693,19 +4245,30 @@ ApplySubstitutions() {
       auto DS = GetSubstitution(VE, true);
       DS->remSave();
       if (!DS->getSave() && !IsToBeKilled(DS)) {
-        KillList.push_back(VExprToInst[DS]);
+        AddToKillList(VExprToInst[DS]);
       }
     }
 
     SE->addSave(RealUses);
     VI->replaceAllUsesWith(SI);
-    SSAPREInstrSubstituted++;
+    Stats.InstrSubstituted++;
+    Eliminated.push_back({VI, SI});
 
-    KillList.push_back(VI);
+    AddToKillList(VI);
 
     Changed = true;
   }
 
+  std::sort(Eliminated.begin(), Eliminated.end(),
+            [&](const std::pair<Instruction *, Value *> &A,
+                const std::pair<Instruction *, Value *> &B) {
+              return InstrDFS.lookup(A.first) < InstrDFS.lookup(B.first);
+            });
+  for (auto &P : Eliminated)
+    ORE->emit(OptimizationRemark(DEBUG_TYPE, "Eliminated", P.first)
+              << ore::NV("Instruction", P.first) << " eliminated, replaced by "
+              << ore::NV("Replacement", P.second));
+
   return Changed;
 }
 
@@ -2718,7 +4281,9 @@ KillEmAll() {
   // other instructions. For example if we delete the last user of a value and
   // the instruction that produces this value does not have any side effects we
   // can delete it, and so on.
-  for (unsigned i = 0, l = KillList.size(); i < l; ++i) {
+  // Every instruction is on the list only once, so this is linear in the
+  // number of deleted instructions.
+  for (unsigned i = 0; i < KillList.size(); ++i) {
     auto I = KillList[i];
 
     assert(AllUsersKilled(I) && "Should not be used by live instructions");
@@ -2728,10 +4293,7 @@ KillEmAll() {
       if (auto &OE = ValueToExp[O]) {
         if (IgnoreExpression(OE)) continue;
         OE->remSave();
-        if (!OE->getSave()) {
-          KillList.push_back(VExprToInst[OE]);
-          l++;
-        }
+        if (!OE->getSave()) AddToKillList(VExprToInst[OE]);
       }
     }
 
@@ -2739,22 +4301,17 @@ KillEmAll() {
     I->dropAllReferences();
   }
 
-  // Clear Protos
-  for (auto &P : PExprToInsts) {
-    auto *Proto = P.getFirst()->getProto();
-    if (Proto)
-      Proto->dropAllReferences();
-  }
-
   // Remove instructions completely
   while (!KillList.empty()) {
     auto K = KillList.pop_back_val();
     if (!K->getParent()) continue;
+    if (auto MA = MSSA->getMemoryAccess(K))
+      MSSAU->removeMemoryAccess(MA);
     K->eraseFromParent();
     if (PHINode::classof(K))
-      SSAPREPHIKilled++;
+      Stats.PHIKilled++;
     else
-      SSAPREInstrKilled++;
+      Stats.InstrKilled++;
     Changed = true;
   }
 
@@ -2767,19 +4324,39 @@ CodeMotion() {
 
   auto PI = (PrintInfo)(PI_Default | PI_Kill);
 
-  Changed |= FactorGraphWalkBottomUp();
+  {
+    NamedRegionTimer T("bottomup", "CodeMotion.FactorGraphWalkBottomUp",
+                       SSAPRETimerGroup, SSAPRETimerGroupDesc, TimePhases);
+    Changed |= FactorGraphWalkBottomUp();
+  }
   DEBUG(PrintDebug("CodeMotion.FactorGraphWalkBottomUp", PI));
 
-  Changed |= FactorGraphWalkTopBottom();
+  {
+    NamedRegionTimer T("topbottom", "CodeMotion.FactorGraphWalkTopBottom",
+                       SSAPRETimerGroup, SSAPRETimerGroupDesc, TimePhases);
+    Changed |= FactorGraphWalkTopBottom();
+  }
   DEBUG(PrintDebug("CodeMotion.FactorGraphWalkTopBottom", PI));
 
-  Changed |= PHIInsertion();
+  {
+    NamedRegionTimer T("phiinsertion", "CodeMotion.PHIInsertion",
+                       SSAPRETimerGroup, SSAPRETimerGroupDesc, TimePhases);
+    Changed |= PHIInsertion();
+  }
   DEBUG(PrintDebug("CodeMotion.PHIInsertion", PI));
 
-  Changed |= ApplySubstitutions();
+  {
+    NamedRegionTimer T("substitutions", "CodeMotion.ApplySubstitutions",
+                       SSAPRETimerGroup, SSAPRETimerGroupDesc, TimePhases);
+    Changed |= ApplySubstitutions();
+  }
   DEBUG(PrintDebug("CodeMotion.ApplySubstitutions", PI));
 
-  Changed |= KillEmAll();
+  {
+    NamedRegionTimer T("kill", "CodeMotion.KillEmAll",
+                       SSAPRETimerGroup, SSAPRETimerGroupDesc, TimePhases);
+    Changed |= KillEmAll();
+  }
   // DEBUG(PrintDebug("CodeMotion.KillEmAll"));
 
   return Changed;
@@ -2789,7 +4366,7 @@ void SSAPRE::
 PrintDebugInstructions() {
   dbgs() << "\n-Program----------------------------------\n";
 
-  for (auto &B : *RPOT) {
+  for (auto B : RPOBlocks) {
     for (auto &I : *B) {
       dbgs() << "\n" << InstrSDFS[&I];
       dbgs() << "\t" << InstrDFS[&I];
@@ -2805,7 +4382,7 @@ PrintDebugExpressions(bool PrintIgnored) {
   dbgs() << "\n-Expressions-----------------------------\n";
 
   for (auto &P : PExprToInsts) {
-    auto &PE = P.getFirst();
+    auto &PE = P.first;
     if (IgnoreExpression(PE)) continue;
     dbgs() << "\n";
     dbgs() << ExpressionTypeToString(PE->getExpressionType());
@@ -2829,7 +4406,7 @@ PrintDebugExpressions(bool PrintIgnored) {
   if (PrintIgnored) {
     dbgs() << "--------\n";
     for (auto &P : PExprToInsts) {
-      auto &PE = P.getFirst();
+      auto &PE = P.first;
       if (!IgnoreExpression(PE)) continue;
       dbgs() << "\n";
       dbgs() << ExpressionTypeToString(PE->getExpressionType());
@@ -2857,7 +4434,7 @@ void SSAPRE::
 PrintDebugFactors() {
   dbgs() << "\n-BlockToFactors--------------------------\n";
 
-  for (auto &B : *RPOT) {
+  for (auto B : RPOBlocks) {
     auto BTF = BlockToFactors[B];
     if (!BTF.size()) continue;
     dbgs() << "\n(" << BTF.size() << ") ";
@@ -2880,7 +4457,7 @@ PrintDebugSubstitutions() {
   bool PrintHeader = true;
   for (auto &PP : Substitutions) {
     auto PE = PP.getFirst();
-    auto &MA = PP.getSecond();
+    auto &MA = PP.getSecond().Parent;
 
     if (!MA.size()) continue;
 
@@ -2982,58 +4559,213 @@ PrintDebug(const std::string &Caption, PrintInfo PI) {
   dbgs() << "\n------------------------------------------------------------\n";
 }
 
-PreservedAnalyses SSAPRE::
-runImpl(Function &F,
+void SSAPRE::
+Prepare(Function &F,
         AssumptionCache &_AC,
-        TargetLibraryInfo &_TLI, DominatorTree &_DT) {
+        TargetLibraryInfo &_TLI, TargetTransformInfo &_TTI, DominatorTree &_DT,
+        MemorySSA &_MSSA, BlockFrequencyInfo *_BFI,
+        OptimizationRemarkEmitter &_ORE) {
   DEBUG(dbgs() << "SSAPRE(" << this << ") running on " << F.getName());
 
-  bool Changed = false;
-
   TLI = &_TLI;
+  TTI = &_TTI;
   DL = &F.getParent()->getDataLayout();
   AC = &_AC;
   DT = &_DT;
+  MSSA = &_MSSA;
+  MSSAWalker = MSSA->getWalker();
+  MSSAU = make_unique<MemorySSAUpdater>(MSSA);
+  BFI = _BFI;
+  ORE = &_ORE;
   Func = &F;
+  CFGChanged = false;
+  IRChanged = false;
+  Stats = RunStatistics();
+  TimePhases = TimePassesIsEnabled && !ContextLock;
 
   NumFuncArgs = F.arg_size();
 
-  RPOT = new ReversePostOrderTraversal<Function *>(&F);
+  // Reuse the storage of the previous run
+  RPOBlocks.clear();
+  for (auto B : post_order(&F)) RPOBlocks.push_back(B);
+  std::reverse(RPOBlocks.begin(), RPOBlocks.end());
 
   DEBUG(F.dump());
 
-  Init(F);
+  {
+    NamedRegionTimer T("sinking", "StoreSinking", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    IRChanged = StoreSinking();
+  }
+
+  if (SSAPREStrengthReduction) {
+    NamedRegionTimer T("strength", "StrengthReduction", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    IRChanged |= StrengthReduction();
+  }
+
+  {
+    NamedRegionTimer T("init", "Init", SSAPRETimerGroup, SSAPRETimerGroupDesc,
+                       TimePhases);
+    Init(F);
+  }
 
-  FactorInsertion();
+  {
+    NamedRegionTimer T("insertion", "FactorInsertion", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    FactorInsertion();
+  }
+}
 
-  Rename();
+void SSAPRE::
+Analyze() {
+  {
+    NamedRegionTimer T("rename", "Rename", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    Rename();
+    BuildFactorGraph();
+  }
 
-  DownSafety();
+  {
+    NamedRegionTimer T("downsafety", "DownSafety", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    DownSafety();
+  }
   DEBUG(PrintDebug("STEP 3: DownSafety"));
 
-  WillBeAvail();
+  {
+    NamedRegionTimer T("willbeavail", "WillBeAvail", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    WillBeAvail();
+  }
   DEBUG(PrintDebug("STEP 4: WillBeAvail"));
 
-  Finalize();
+  {
+    NamedRegionTimer T("finalize", "Finalize", SSAPRETimerGroup,
+                       SSAPRETimerGroupDesc, TimePhases);
+    Finalize();
+  }
   DEBUG(PrintDebug("STEP 5: Finalize"));
+}
 
-  Changed = CodeMotion();
+PreservedAnalyses SSAPRE::
+Apply() {
+  IRChanged |= CodeMotion();
 
   Fini();
 
-  DEBUG(F.dump());
+  DEBUG(Func->dump());
 
-  if (!Changed)
+  if (!IRChanged)
     return PreservedAnalyses::all();
 
-  return PreservedAnalyses::none();
+  // The dominator tree is updated for every split edge and MemorySSA is kept
+  // up to date, the rest of the CFG analyses survive only if nothing was split
+  PreservedAnalyses PA;
+  if (!CFGChanged) PA.preserveSet<CFGAnalyses>();
+  PA.preserve<DominatorTreeAnalysis>();
+  PA.preserve<MemorySSAAnalysis>();
+  PA.preserve<GlobalsAA>();
+  return PA;
+}
+
+PreservedAnalyses SSAPRE::
+runImpl(Function &F,
+        AssumptionCache &_AC,
+        TargetLibraryInfo &_TLI, TargetTransformInfo &_TTI, DominatorTree &_DT,
+        MemorySSA &_MSSA, BlockFrequencyInfo *_BFI,
+        OptimizationRemarkEmitter &_ORE) {
+  Prepare(F, _AC, _TLI, _TTI, _DT, _MSSA, _BFI, _ORE);
+  Analyze();
+  return Apply();
 }
 
 PreservedAnalyses SSAPRE::run(Function &F, AnalysisManager<Function> &AM) {
+  BlockFrequencyInfo *BFI = nullptr;
+  if (SSAPREProfileGuided && F.getEntryCount())
+    BFI = &AM.getResult<BlockFrequencyAnalysis>(F);
+
   return runImpl(F,
       AM.getResult<AssumptionAnalysis>(F),
       AM.getResult<TargetLibraryAnalysis>(F),
-      AM.getResult<DominatorTreeAnalysis>(F));
+      AM.getResult<TargetIRAnalysis>(F),
+      AM.getResult<DominatorTreeAnalysis>(F),
+      AM.getResult<MemorySSAAnalysis>(F).getMSSA(),
+      BFI,
+      AM.getResult<OptimizationRemarkEmitterAnalysis>(F));
+}
+
+
+//===----------------------------------------------------------------------===//
+// Parallel Driver
+//===----------------------------------------------------------------------===//
+
+PreservedAnalyses SSAPREParallelPass::run(Module &M, ModuleAnalysisManager &AM) {
+  auto &FAM = AM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+  unsigned Threads = SSAPREThreads;
+  if (!Threads) Threads = std::max(1U, std::thread::hardware_concurrency());
+  ThreadPool Pool(Threads);
+  std::mutex ContextLock;
+
+  // The runs of a batch are alive at the same time, their storage is reused
+  // by the next batch
+  std::vector<SSAPRE> Runs(std::max(1U, (unsigned)SSAPREBatchSize));
+  SmallVector<Function *, 64> Batch;
+
+  bool Changed = false;
+  auto RunBatch = [&]() {
+    // Analyses are computed and expressions are created one function at a
+    // time, both may touch the LLVMContext
+    for (unsigned i = 0, l = Batch.size(); i < l; ++i) {
+      auto &F = *Batch[i];
+      BlockFrequencyInfo *BFI = nullptr;
+      if (SSAPREProfileGuided && F.getEntryCount())
+        BFI = &FAM.getResult<BlockFrequencyAnalysis>(F);
+
+      Runs[i].ContextLock = &ContextLock;
+      Runs[i].Prepare(F,
+          FAM.getResult<AssumptionAnalysis>(F),
+          FAM.getResult<TargetLibraryAnalysis>(F),
+          FAM.getResult<TargetIRAnalysis>(F),
+          FAM.getResult<DominatorTreeAnalysis>(F),
+          FAM.getResult<MemorySSAAnalysis>(F).getMSSA(),
+          BFI,
+          FAM.getResult<OptimizationRemarkEmitterAnalysis>(F));
+    }
+
+    for (unsigned i = 0, l = Batch.size(); i < l; ++i) {
+      auto &R = Runs[i];
+      Pool.async([&R]() { R.Analyze(); });
+    }
+    Pool.wait();
+
+    // The IR is changed in module order regardless of the schedule above
+    for (unsigned i = 0, l = Batch.size(); i < l; ++i) {
+      auto PA = Runs[i].Apply();
+      Changed |= !PA.areAllPreserved();
+      FAM.invalidate(*Batch[i], PA);
+    }
+
+    Batch.clear();
+  };
+
+  for (auto &F : M) {
+    if (F.isDeclaration()) continue;
+    Batch.push_back(&F);
+    if (Batch.size() == Runs.size()) RunBatch();
+  }
+  if (!Batch.empty()) RunBatch();
+
+  if (!Changed)
+    return PreservedAnalyses::all();
+
+  // Function analyses were invalidated above, one function at a time
+  PreservedAnalyses PA;
+  PA.preserveSet<AllAnalysesOn<Function>>();
+  PA.preserve<FunctionAnalysisManagerModuleProxy>();
+  PA.preserve<GlobalsAA>();
+  return PA;
 }
 
 
@@ -3059,8 +4791,14 @@ public:
 
     auto &AC = getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
     auto &TLI = getAnalysis<TargetLibraryInfoWrapperPass>().getTLI();
+    auto &TTI = getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
     auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
-    auto PA = Impl.runImpl(F, AC, TLI, DT);
+    auto &MSSA = getAnalysis<MemorySSAWrapperPass>().getMSSA();
+    BlockFrequencyInfo *BFI = nullptr;
+    if (SSAPREProfileGuided && F.getEntryCount())
+      BFI = &getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
+    auto &ORE = getAnalysis<OptimizationRemarkEmitterWrapperPass>().getORE();
+    auto PA = Impl.runImpl(F, AC, TLI, TTI, DT, MSSA, BFI, ORE);
     return !PA.areAllPreserved();
   }
 
@@ -3068,7 +4806,15 @@ private:
   void getAnalysisUsage(AnalysisUsage &AU) const override {
     AU.addRequired<AssumptionCacheTracker>();
     AU.addRequired<TargetLibraryInfoWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
     AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<MemorySSAWrapperPass>();
+    AU.addRequired<OptimizationRemarkEmitterWrapperPass>();
+    if (SSAPREProfileGuided)
+      AU.addRequired<BlockFrequencyInfoWrapperPass>();
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addPreserved<MemorySSAWrapperPass>();
+    AU.addPreserved<GlobalsAAWrapperPass>();
   }
 };
 
@@ -3081,10 +4827,13 @@ INITIALIZE_PASS_BEGIN(SSAPRELegacy,
                       "ssapre",
                       "SSA Partial Redundancy Elimination",
                       false, false)
-INITIALIZE_PASS_DEPENDENCY(BreakCriticalEdges)
 INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
 INITIALIZE_PASS_DEPENDENCY(TargetLibraryInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
 INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(MemorySSAWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(OptimizationRemarkEmitterWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(BlockFrequencyInfoWrapperPass)
 INITIALIZE_PASS_END(SSAPRELegacy,
                     "ssapre",
                     "SSA Partial Redundancy Elimination",
@@ -0,0 +1,69 @@
+; RUN: opt < %s -aa-pipeline=basic-aa -passes=gvn -S | FileCheck %s --check-prefix=PRE
+; RUN: opt < %s -aa-pipeline=basic-aa -passes=gvn-no-pre -S | FileCheck %s --check-prefix=NOPRE
+
+; With NoPRE neither the scalar nor the load partial redundancy is removed,
+; the full one still is
+
+; PRE-LABEL:   @scalar(
+; PRE:         %.pre = add i32 %p, 1
+; PRE:         phi i32
+; NOPRE-LABEL: @scalar(
+; NOPRE-NOT:   .pre
+; NOPRE:       block4:
+; NOPRE-NEXT:  %b = add i32 %p, 1
+; NOPRE-NEXT:  ret i32 %b
+define i32 @scalar(i32 %p, i1 %c) {
+block1:
+  br i1 %c, label %block2, label %block3
+
+block2:
+  %a = add i32 %p, 1
+  call void @use(i32 %a)
+  br label %block4
+
+block3:
+  br label %block4
+
+block4:
+  %b = add i32 %p, 1
+  ret i32 %b
+}
+
+; PRE-LABEL:   @load(
+; PRE:         %v2.pre = load i32, i32* %p
+; PRE:         phi i32
+; NOPRE-LABEL: @load(
+; NOPRE-NOT:   .pre
+; NOPRE:       block4:
+; NOPRE-NEXT:  %v2 = load i32, i32* %p
+; NOPRE-NEXT:  ret i32 %v2
+define i32 @load(i32* noalias %p, i32* noalias %q, i1 %c) {
+block1:
+  br i1 %c, label %block2, label %block3
+
+block2:
+  %v1 = load i32, i32* %p
+  store i32 %v1, i32* %q
+  br label %block4
+
+block3:
+  br label %block4
+
+block4:
+  %v2 = load i32, i32* %p
+  ret i32 %v2
+}
+
+; NOPRE-LABEL: @full(
+; NOPRE:       add i32 %p, 1
+; NOPRE-NOT:   add
+; NOPRE:       ret
+define i32 @full(i32 %p) {
+entry:
+  %a = add i32 %p, 1
+  call void @use(i32 %a)
+  %b = add i32 %p, 1
+  ret i32 %b
+}
+
+declare void @use(i32)
@@ -0,0 +1,87 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+declare { i32, i1 } @llvm.sadd.with.overflow.i32(i32, i32)
+declare void @fail()
+
+; The overflow check is repeated after the first one
+; CHECK-LABEL: @overflow_twice(
+; CHECK:       call { i32, i1 } @llvm.sadd.with.overflow.i32
+; CHECK:       extractvalue { i32, i1 } %{{.*}}, 1
+; CHECK-NOT:   call
+; CHECK-NOT:   extractvalue { i32, i1 } %{{.*}}, 1
+; CHECK:       ret
+define i32 @overflow_twice(i32 %a, i32 %b) {
+entry:
+  %s1 = call { i32, i1 } @llvm.sadd.with.overflow.i32(i32 %a, i32 %b)
+  %o1 = extractvalue { i32, i1 } %s1, 1
+  br i1 %o1, label %bad, label %next
+
+next:
+  %s2 = call { i32, i1 } @llvm.sadd.with.overflow.i32(i32 %a, i32 %b)
+  %o2 = extractvalue { i32, i1 } %s2, 1
+  br i1 %o2, label %bad, label %ok
+
+ok:
+  %v = extractvalue { i32, i1 } %s2, 0
+  ret i32 %v
+
+bad:
+  call void @fail()
+  ret i32 0
+}
+
+; Different indices are different expressions
+; CHECK-LABEL: @extract_indices(
+; CHECK:       extractvalue { i32, i32 } %p, 0
+; CHECK:       extractvalue { i32, i32 } %p, 1
+; CHECK-NOT:   extractvalue
+; CHECK:       ret
+define i32 @extract_indices({ i32, i32 } %p) {
+entry:
+  %a = extractvalue { i32, i32 } %p, 0
+  %b = extractvalue { i32, i32 } %p, 1
+  %c = extractvalue { i32, i32 } %p, 0
+  %r1 = add i32 %a, %b
+  %r = add i32 %r1, %c
+  ret i32 %r
+}
+
+; CHECK-LABEL: @insert_twice(
+; CHECK:       insertvalue
+; CHECK-NOT:   insertvalue
+; CHECK:       ret
+define { i32, i32 } @insert_twice({ i32, i32 } %p, i32 %x, i1 %c) {
+entry:
+  %a = insertvalue { i32, i32 } %p, i32 %x, 1
+  br i1 %c, label %left, label %merge
+
+left:
+  %u = extractvalue { i32, i32 } %a, 0
+  call void @fail()
+  br label %merge
+
+merge:
+  %b = insertvalue { i32, i32 } %p, i32 %x, 1
+  ret { i32, i32 } %b
+}
+
+; The aggregates are read from memory that is written between them, the
+; extracts of the second one are not those of the first
+; CHECK-LABEL: @extract_clobbered(
+; CHECK:       %s1 = load { i32, i32 }, { i32, i32 }* %p
+; CHECK:       extractvalue { i32, i32 } %s1, 0
+; CHECK:       store
+; CHECK:       %s2 = load { i32, i32 }, { i32, i32 }* %p
+; CHECK:       extractvalue { i32, i32 } %s2, 0
+; CHECK:       ret
+define i32 @extract_clobbered({ i32, i32 }* %p, i32* %q) {
+entry:
+  %s1 = load { i32, i32 }, { i32, i32 }* %p
+  %a = extractvalue { i32, i32 } %s1, 0
+  store i32 %a, i32* %q
+  %s2 = load { i32, i32 }, { i32, i32 }* %p
+  %b = extractvalue { i32, i32 } %s2, 0
+  %r = add i32 %a, %b
+  ret i32 %r
+}
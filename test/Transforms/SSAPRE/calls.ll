@@ -0,0 +1,119 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+; RUN: opt < %s -passes='ssapre,print<memoryssa>' -verify-memoryssa -disable-output
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+declare double @llvm.sqrt.f64(double)
+declare double @exp(double) readnone nounwind
+declare double @maythrow(double) readnone
+declare i64 @len(i8*) readonly nounwind
+
+;  -------------  -------------      -------------  -------------
+;   %e1 = exp(x)   %e2 = exp(x)        %e1 = exp(x)   %e2 = exp(x)
+;   use %e1        use %e2             use %e1        use %e2
+;  -------------  -------------      -------------  -------------
+;          \       /            \\           \       /
+;        -------------          //         -------------
+;         %e3 = exp(x)                      phi(%e1, %e2)
+;        -------------                     -------------
+; CHECK-LABEL: @call_both_sides(
+; CHECK:       call double @exp
+; CHECK:       call double @exp
+; CHECK:       phi double
+; CHECK-NOT:   call
+; CHECK:       ret
+define double @call_both_sides(double %x, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %e1 = call double @exp(double %x)
+  %u1 = fadd double %e1, 1.0
+  br label %merge
+
+right:
+  %e2 = call double @exp(double %x)
+  %u2 = fmul double %e2, 2.0
+  br label %merge
+
+merge:
+  %u = phi double [ %u1, %left ], [ %u2, %right ]
+  %e3 = call double @exp(double %x)
+  %r = fadd double %u, %e3
+  ret double %r
+}
+
+;  -------------  -------------      -------------  -------------
+;   %s1 = sqrt(x)                      %s1 = sqrt(x)  %s2 = sqrt(x)
+;   use %s1                            use %s1
+;  -------------  -------------      -------------  -------------
+;          \       /            \\           \       /
+;        -------------          //         -------------
+;         %s3 = sqrt(x)                     phi(%s1, %s2)
+;        -------------                     -------------
+; CHECK-LABEL: @call_intrinsic(
+; CHECK:       left:
+; CHECK:       call double @llvm.sqrt.f64
+; CHECK:       right:
+; CHECK-NEXT:  call double @llvm.sqrt.f64
+; CHECK:       merge:
+; CHECK:       phi double
+; CHECK-NOT:   call
+; CHECK:       ret
+define double @call_intrinsic(double %x, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %s1 = call double @llvm.sqrt.f64(double %x)
+  %u1 = fadd double %s1, 1.0
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %u = phi double [ %u1, %left ], [ 0.0, %right ]
+  %s3 = call double @llvm.sqrt.f64(double %x)
+  %r = fadd double %u, %s3
+  ret double %r
+}
+
+; The store between the calls changes what the second one reads
+; CHECK-LABEL: @call_readonly(
+; CHECK:       call i64 @len
+; CHECK:       store
+; CHECK-NEXT:  call i64 @len
+; CHECK:       phi i64
+; CHECK-NOT:   call
+; CHECK:       ret
+define i64 @call_readonly(i8* %p, i1 %c) {
+entry:
+  %a = call i64 @len(i8* %p)
+  %a1 = add i64 %a, 1
+  br i1 %c, label %left, label %right
+
+left:
+  store i8 0, i8* %p
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %b = call i64 @len(i8* %p)
+  %r = add i64 %a1, %b
+  ret i64 %r
+}
+
+; Calls that may throw are left alone
+; CHECK-LABEL: @call_maythrow(
+; CHECK:       call double @maythrow
+; CHECK:       call double @maythrow
+; CHECK:       ret
+define double @call_maythrow(double %x) {
+entry:
+  %a = call double @maythrow(double %x)
+  %b = call double @maythrow(double %x)
+  %r = fadd double %a, %b
+  ret double %r
+}
@@ -0,0 +1,88 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+declare void @fail()
+
+; The same range check is made twice
+; CHECK-LABEL: @cmp_dominated(
+; CHECK:       icmp ult
+; CHECK-NOT:   icmp
+; CHECK:       ret
+define i32 @cmp_dominated(i32 %i, i32 %n) {
+entry:
+  %c1 = icmp ult i32 %i, %n
+  br i1 %c1, label %check, label %bad
+
+check:
+  %c2 = icmp ult i32 %i, %n
+  br i1 %c2, label %ok, label %bad
+
+ok:
+  ret i32 %i
+
+bad:
+  call void @fail()
+  ret i32 0
+}
+
+; x < y and y > x are the same expression
+; CHECK-LABEL: @cmp_swapped(
+; CHECK:       icmp
+; CHECK-NOT:   icmp
+; CHECK:       ret
+define i1 @cmp_swapped(i32 %x, i32 %y) {
+entry:
+  %a = icmp slt i32 %x, %y
+  %b = icmp sgt i32 %y, %x
+  %r = and i1 %a, %b
+  ret i1 %r
+}
+
+; Different predicates on the same operands are not
+; CHECK-LABEL: @cmp_predicates(
+; CHECK:       icmp slt
+; CHECK:       icmp sle
+; CHECK:       ret
+define i1 @cmp_predicates(i32 %x, i32 %y) {
+entry:
+  %a = icmp slt i32 %x, %y
+  %b = icmp sle i32 %x, %y
+  %r = and i1 %a, %b
+  ret i1 %r
+}
+
+;  -------------  -------------      -------------  -------------
+;   %c1 = x < y                        %c1 = x < y    %c2 = x < y
+;   use %c1                            use %c1
+;  -------------  -------------      -------------  -------------
+;          \       /            \\           \       /
+;        -------------          //         -------------
+;         %c3 = x < y                       phi(%c1, %c2)
+;        -------------                     -------------
+; CHECK-LABEL: @fcmp_partial(
+; CHECK:       left:
+; CHECK:       fcmp olt
+; CHECK:       right:
+; CHECK-NEXT:  fcmp olt
+; CHECK:       merge:
+; CHECK:       phi i1
+; CHECK-NOT:   fcmp
+; CHECK:       ret
+define i32 @fcmp_partial(double %x, double %y, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %c1 = fcmp olt double %x, %y
+  %u1 = zext i1 %c1 to i32
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %u = phi i32 [ %u1, %left ], [ 0, %right ]
+  %c3 = fcmp olt double %x, %y
+  %s = select i1 %c3, i32 %u, i32 1
+  ret i32 %s
+}
@@ -0,0 +1,88 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+; RUN: opt < %s -ssapre -verify-dom-info -verify-memoryssa -disable-output
+; RUN: opt < %s -aa-pipeline=basic-aa -passes='ssapre,print<memoryssa>' \
+; RUN:   -verify-memoryssa -disable-output 2>&1 | FileCheck %s --check-prefix=MSSA
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;
+;       -------------                        -------------
+;         /       |                            /       |
+;  -------------  |              \\    -------------  -------------
+;   %b1 = %a+1    |              //     %b1 = %a+1      %a+1
+;  -------------  |                    -------------  -------------
+;         \       |                            \       /
+;       -------------                        -------------
+;        %b2 = %a+1                           phi
+;       -------------                        -------------
+; The insertion goes on the critical edge, it is split for that
+; CHECK-LABEL: @split_critical(
+; CHECK:       entry.merge_crit_edge:
+; CHECK-NEXT:  add i32 %a, 1
+; CHECK:       merge:
+; CHECK:       phi
+; CHECK-NOT:   add
+; CHECK:       ret
+define i32 @split_critical(i32 %a, i1 %c) {
+entry:
+  br i1 %c, label %left, label %merge
+
+left:
+  %b1 = add i32 %a, 1
+  call void @use(i32 %b1)
+  br label %merge
+
+merge:
+  %b2 = add i32 %a, 1
+  ret i32 %b2
+}
+
+; Nothing is inserted, nothing is split
+; CHECK-LABEL: @no_split(
+; CHECK-NOT:   crit_edge
+; CHECK:       ret
+define i32 @no_split(i32 %a, i1 %c) {
+entry:
+  br i1 %c, label %left, label %merge
+
+left:
+  %b1 = add i32 %a, 1
+  br label %merge
+
+merge:
+  %b2 = add i32 %a, 2
+  ret i32 %b2
+}
+
+; The load is anticipated at %merge, but %entry also leads to %left. It goes
+; to the block on the split edge, which the MemoryPhi of %merge is rebound to.
+; CHECK-LABEL: @split_load(
+; CHECK:       entry.merge_crit_edge:
+; CHECK-NEXT:  load i32, i32* %p
+; CHECK:       merge:
+; CHECK-NEXT:  phi i32
+; CHECK-NOT:   load
+; CHECK:       ret
+; MSSA-LABEL:  @split_load(
+; MSSA:        entry.merge_crit_edge:
+; MSSA-NEXT:   ; MemoryUse(liveOnEntry)
+; MSSA-NEXT:   load i32, i32* %p
+; MSSA:        merge:
+; MSSA-NEXT:   ; 2 = MemoryPhi({entry.merge_crit_edge,liveOnEntry},{left,1})
+; MSSA-NOT:    MemoryUse
+; MSSA:        ret
+define i32 @split_load(i32* noalias %p, i32* noalias %q, i1 %c) {
+entry:
+  br i1 %c, label %left, label %merge
+
+left:
+  %v1 = load i32, i32* %p
+  store i32 %v1, i32* %q
+  br label %merge
+
+merge:
+  %v2 = load i32, i32* %p
+  ret i32 %v2
+}
+
+declare void @use(i32)
@@ -0,0 +1,150 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+; RUN: opt < %s -passes='ssapre,print<memoryssa>' -verify-memoryssa -disable-output
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;        %a = load %p                         %a = load %p
+;        use %a                               use %a
+;       -------------                        -------------
+;         /       \                            /       \
+;  -------------  -------------  \\    -------------  -------------
+;   store %p                     //     store %p
+;  -------------  -------------         %l = load %p
+;         \       /                    -------------  -------------
+;       -------------                          \       /
+;        %b = load %p                        -------------
+;       -------------                         phi(%l, %a)
+;                                            -------------
+; CHECK-LABEL: @load_diamond(
+; CHECK:       load
+; CHECK:       store
+; CHECK-NEXT:  load
+; CHECK:       phi
+; CHECK-NOT:   load
+; CHECK:       ret
+define i32 @load_diamond(i32* %p, i1 %c) {
+entry:
+  %a = load i32, i32* %p, align 4
+  %a1 = add i32 %a, 1
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 0, i32* %p, align 4
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %b = load i32, i32* %p, align 4
+  %r = add i32 %a1, %b
+  ret i32 %r
+}
+
+; Both sides clobber the memory, there is nothing to reuse. The stores are
+; sunk into the join, the load stays after them.
+; CHECK-LABEL: @load_diamond_clobbered(
+; CHECK:       merge:
+; CHECK-NEXT:  %storemerge = phi i32
+; CHECK-NEXT:  store i32 %storemerge, i32* %p
+; CHECK-NEXT:  %b = load i32, i32* %p
+; CHECK:       ret
+define i32 @load_diamond_clobbered(i32* %p, i1 %c) {
+entry:
+  %a = load i32, i32* %p, align 4
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 0, i32* %p, align 4
+  br label %merge
+
+right:
+  store i32 1, i32* %p, align 4
+  br label %merge
+
+merge:
+  %b = load i32, i32* %p, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+; A store to a different object does not clobber the load
+; CHECK-LABEL: @load_noalias_store(
+; CHECK:       load
+; CHECK:       store
+; CHECK-NOT:   load
+; CHECK:       ret
+define i32 @load_noalias_store(i32* noalias %p, i32* noalias %q) {
+entry:
+  %a = load i32, i32* %p, align 4
+  store i32 0, i32* %q, align 4
+  %b = load i32, i32* %p, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
+
+;       -------------                        -------------
+;                                             %v = load %p
+;       -------------                        -------------
+;             |                                    |
+;       -------------  <-.           \\      -------------  <-.
+;        %v = load %p    |           //       store %v, %q    |
+;        store %v, %q    |                   -------------    |
+;       -------------  --.                         |        --.
+; CHECK-LABEL: @load_loop_invariant(
+; CHECK:       entry:
+; CHECK-NEXT:  load
+; CHECK:       loop:
+; CHECK-NOT:   load
+; CHECK:       ret
+define i32 @load_loop_invariant(i32* noalias %p, i32* noalias %q, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, i32* %p, align 4
+  store i32 %v, i32* %q, align 4
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %v
+}
+
+; The store inside the loop changes the loaded value on every iteration
+; CHECK-LABEL: @load_loop_clobbered(
+; CHECK:       loop:
+; CHECK:       load
+; CHECK:       store
+; CHECK:       ret
+define i32 @load_loop_clobbered(i32* %p, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %v = load i32, i32* %p, align 4
+  %v.next = add i32 %v, 1
+  store i32 %v.next, i32* %p, align 4
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %v
+}
+
+; Volatile loads are never touched
+; CHECK-LABEL: @load_volatile(
+; CHECK:       load volatile
+; CHECK:       load volatile
+; CHECK:       ret
+define i32 @load_volatile(i32* %p) {
+entry:
+  %a = load volatile i32, i32* %p, align 4
+  %b = load volatile i32, i32* %p, align 4
+  %r = add i32 %a, %b
+  ret i32 %r
+}
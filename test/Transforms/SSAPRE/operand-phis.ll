@@ -0,0 +1,163 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;
+;       -------------                        -------------
+;         /       \                            /       \
+;  -------------  -------------  \\    -------------  -------------
+;   %b1 = %a1+1    %b2 = %a2+1   //     %b1 = %a1+1    %b2 = %a2+1
+;  -------------  -------------        -------------  -------------
+;         \       /                            \       /
+;       -------------                        -------------
+;        %a3 = phi(%a1, %a2)                  phi(%b1, %b2)
+;        %b3 = %a3+1
+;       -------------                        -------------
+; CHECK-LABEL: @phi_translated_full(
+; CHECK:       merge:
+; CHECK:       phi i32 [ %b2, %right ], [ %b1, %left ]
+; CHECK-NOT:   add
+; CHECK:       ret
+define i32 @phi_translated_full(i32 %a1, i32 %a2, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %b1 = add i32 %a1, 1
+  call void @use(i32 %b1)
+  br label %merge
+
+right:
+  %b2 = add i32 %a2, 1
+  call void @use(i32 %b2)
+  br label %merge
+
+merge:
+  %a3 = phi i32 [ %a1, %left ], [ %a2, %right ]
+  %b3 = add i32 %a3, 1
+  ret i32 %b3
+}
+
+;       -------------                        -------------
+;
+;       -------------                        -------------
+;         /       \                            /       \
+;  -------------  -------------  \\    -------------  -------------
+;   %b1 = %a1+1                  //     %b1 = %a1+1    %a2+1
+;  -------------  -------------        -------------  -------------
+;         \       /                            \       /
+;       -------------                        -------------
+;        %a3 = phi(%a1, %a2)                  phi(%b1, %a2+1)
+;        %b3 = %a3+1
+;       -------------                        -------------
+; CHECK-LABEL: @phi_translated_partial(
+; CHECK:       right:
+; CHECK-NEXT:  add i32 %a2, 1
+; CHECK:       merge:
+; CHECK:       phi i32 [ {{.*}}, %right ], [ %b1, %left ]
+; CHECK-NOT:   add
+; CHECK:       ret
+define i32 @phi_translated_partial(i32 %a1, i32 %a2, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %b1 = add i32 %a1, 1
+  call void @use(i32 %b1)
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %a3 = phi i32 [ %a1, %left ], [ %a2, %right ]
+  %b3 = add i32 %a3, 1
+  ret i32 %b3
+}
+
+; Neither side computes the translated expression, nothing changes
+; CHECK-LABEL: @phi_translated_none(
+; CHECK:       merge:
+; CHECK-NEXT:  phi i32 [ %a1, %left ], [ %a2, %right ]
+; CHECK-NEXT:  add
+; CHECK:       ret
+define i32 @phi_translated_none(i32 %a1, i32 %a2, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %a3 = phi i32 [ %a1, %left ], [ %a2, %right ]
+  %b3 = add i32 %a3, 1
+  ret i32 %b3
+}
+
+; The row offset %i*16 is invariant in %inner, its Factor there is killed along
+; with the inductions of %k. The operand of the add that uses it then has no
+; earlier occurrence, it must be taken where it is defined.
+; CHECK-LABEL: @matmul_inner(
+; CHECK:       rows:
+; CHECK:       mul i32 %i, 16
+; CHECK:       inner:
+; CHECK-NOT:   mul i32 %i, 16
+; CHECK:       ret
+define void @matmul_inner() {
+entry:
+  br label %rows
+
+rows:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %rows.latch ]
+  br label %cols
+
+cols:
+  %j = phi i32 [ 0, %rows ], [ %j.n, %cols.latch ]
+  br label %inner
+
+inner:
+  %k = phi i32 [ 0, %cols ], [ %k.n, %inner ]
+  %sum = phi i32 [ 0, %cols ], [ %sum.n, %inner ]
+  %row.a = mul i32 %i, 16
+  %ia = add i32 %row.a, %k
+  %ia.64 = sext i32 %ia to i64
+  %pa = getelementptr inbounds [256 x i32], [256 x i32]* @A, i64 0, i64 %ia.64
+  %a = load i32, i32* %pa
+  %row.b = mul i32 %k, 16
+  %ib = add i32 %row.b, %j
+  %ib.64 = sext i32 %ib to i64
+  %pb = getelementptr inbounds [256 x i32], [256 x i32]* @B, i64 0, i64 %ib.64
+  %b = load i32, i32* %pb
+  %p = mul i32 %a, %b
+  %sum.n = add i32 %sum, %p
+  %k.n = add i32 %k, 1
+  %ck = icmp slt i32 %k.n, 16
+  br i1 %ck, label %inner, label %cols.latch
+
+cols.latch:
+  %row.c = mul i32 %i, 16
+  %ic = add i32 %row.c, %j
+  %ic.64 = sext i32 %ic to i64
+  %pc = getelementptr inbounds [256 x i32], [256 x i32]* @C, i64 0, i64 %ic.64
+  store i32 %sum.n, i32* %pc
+  %j.n = add i32 %j, 1
+  %cj = icmp slt i32 %j.n, 16
+  br i1 %cj, label %cols, label %rows.latch
+
+rows.latch:
+  %i.n = add i32 %i, 1
+  %ci = icmp slt i32 %i.n, 16
+  br i1 %ci, label %rows, label %exit
+
+exit:
+  ret void
+}
+
+@A = internal global [256 x i32] zeroinitializer
+@B = internal global [256 x i32] zeroinitializer
+@C = internal global [256 x i32] zeroinitializer
+
+declare void @use(i32)
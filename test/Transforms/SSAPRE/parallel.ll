@@ -0,0 +1,47 @@
+; RUN: opt < %s -passes=ssapre-parallel -ssapre-threads=2 -S | FileCheck %s
+; RUN: opt < %s -passes=ssapre-parallel -ssapre-threads=2 -ssapre-batch-size=1 -S | FileCheck %s
+; RUN: opt < %s -passes=ssapre-parallel -ssapre-threads=1 -S > %t.1
+; RUN: opt < %s -passes=ssapre-parallel -ssapre-threads=4 -S > %t.4
+; RUN: diff %t.1 %t.4
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+; Every function is processed the same way as with -ssapre
+; CHECK-LABEL: @diamond(
+; CHECK:       left:
+; CHECK:       add
+; CHECK:       right:
+; CHECK-NEXT:  add
+; CHECK:       merge:
+; CHECK:       phi
+; CHECK-NOT:   add
+; CHECK:       ret
+define i32 @diamond(i32 %a, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %b1 = add i32 %a, 1
+  call void @use(i32 %b1)
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %b2 = add i32 %a, 1
+  ret i32 %b2
+}
+
+; CHECK-LABEL: @straight(
+; CHECK:       mul
+; CHECK-NOT:   mul
+; CHECK:       ret
+define i32 @straight(i32 %a, i32 %b) {
+entry:
+  %x = mul i32 %a, %b
+  %y = mul i32 %a, %b
+  %r = add i32 %x, %y
+  ret i32 %r
+}
+
+declare void @use(i32)
@@ -0,0 +1,34 @@
+; RUN: opt < %s -O2 -enable-ssapre -debug-pass=Structure -disable-output 2>&1 | FileCheck %s --check-prefix=LEGACY
+; RUN: opt < %s -passes='default<O2>' -enable-ssapre -debug-pass-manager -disable-output 2>&1 | FileCheck %s --check-prefix=NEWPM
+; RUN: opt < %s -passes='default<O3>' -enable-ssapre -debug-pass-manager -disable-output 2>&1 | FileCheck %s --check-prefix=NEWPM
+; RUN: opt < %s -passes='default<O2>' -debug-pass-manager -disable-output 2>&1 | FileCheck %s --check-prefix=DEFAULT
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+; SSAPRE runs right after GVN, in both pass managers
+; LEGACY:      MergedLoadStoreMotion
+; LEGACY:      Global Value Numbering
+; LEGACY:      SSAPRE
+; LEGACY:      MemCpy Optimization
+; NEWPM:       Running pass: MergedLoadStoreMotionPass
+; NEWPM:       Running pass: GVN
+; NEWPM:       Running pass: SSAPRE
+; NEWPM:       Running pass: MemCpyOptPass
+; DEFAULT-NOT: Running pass: SSAPRE
+define i32 @diamond(i32 %a, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %b1 = add i32 %a, 1
+  call void @use(i32 %b1)
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %b2 = add i32 %a, 1
+  ret i32 %b2
+}
+
+declare void @use(i32)
@@ -0,0 +1,147 @@
+; RUN: opt < %s -ssapre -ssapre-profile-guided -S | FileCheck %s
+; RUN: opt < %s -ssapre -S | FileCheck %s --check-prefix=DEFAULT
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;  -------------  -------------      -------------  -------------
+;   %a = x + y      (cold)             %a = x + y     %s = x + y
+;  -------------  -------------      -------------  -------------
+;          \       /            \\           \       /
+;        -------------          //         -------------
+;                                           phi(%a, %s)
+;        -------------                     -------------
+;          /        \                        /        \
+;  -------------     |                -------------     |
+;   %b = x + y (hot) |                 use phi          |
+;  -------------     |                -------------     |
+; The merge is not DownSafe, but a speculative insertion on the cold side
+; removes the computation from the hot one
+; CHECK-LABEL: @speculate_cold(
+; CHECK:       right:
+; CHECK-NEXT:  add i32 %x, %y
+; CHECK:       merge:
+; CHECK-NEXT:  phi i32
+; CHECK:       use:
+; CHECK-NOT:   add
+; CHECK:       exit:
+; DEFAULT-LABEL: @speculate_cold(
+; DEFAULT:       right:
+; DEFAULT-NOT:   add
+; DEFAULT:       use:
+; DEFAULT-NEXT:  add i32 %x, %y
+define i32 @speculate_cold(i32 %x, i32 %y, i1 %c, i1 %d) !prof !0 {
+entry:
+  br i1 %c, label %left, label %right, !prof !1
+
+left:
+  %a = add i32 %x, %y
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %m = phi i32 [ %a, %left ], [ 0, %right ]
+  br i1 %d, label %use, label %exit, !prof !1
+
+use:
+  %b = add i32 %x, %y
+  br label %exit
+
+exit:
+  %r = phi i32 [ %m, %merge ], [ %b, %use ]
+  ret i32 %r
+}
+
+; Same as above, but the insertion side is hot and the use is cold
+; CHECK-LABEL: @speculate_hot(
+; CHECK:       right:
+; CHECK-NOT:   add
+; CHECK:       use:
+; CHECK-NEXT:  add i32 %x, %y
+define i32 @speculate_hot(i32 %x, i32 %y, i1 %c, i1 %d) !prof !0 {
+entry:
+  br i1 %c, label %left, label %right, !prof !2
+
+left:
+  %a = add i32 %x, %y
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %m = phi i32 [ %a, %left ], [ 0, %right ]
+  br i1 %d, label %use, label %exit, !prof !2
+
+use:
+  %b = add i32 %x, %y
+  br label %exit
+
+exit:
+  %r = phi i32 [ %m, %merge ], [ %b, %use ]
+  ret i32 %r
+}
+
+; Without a profile the default placement is used
+; CHECK-LABEL: @no_profile(
+; CHECK:       right:
+; CHECK-NOT:   add
+; CHECK:       use:
+; CHECK-NEXT:  add i32 %x, %y
+define i32 @no_profile(i32 %x, i32 %y, i1 %c, i1 %d) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %a = add i32 %x, %y
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %m = phi i32 [ %a, %left ], [ 0, %right ]
+  br i1 %d, label %use, label %exit
+
+use:
+  %b = add i32 %x, %y
+  br label %exit
+
+exit:
+  %r = phi i32 [ %m, %merge ], [ %b, %use ]
+  ret i32 %r
+}
+
+; A division may trap, it is not inserted on the cold side however hot the use
+; CHECK-LABEL: @speculate_trap(
+; CHECK:       right:
+; CHECK-NOT:   udiv
+; CHECK:       use:
+; CHECK-NEXT:  udiv i32 %x, %y
+define i32 @speculate_trap(i32 %x, i32 %y, i1 %c, i1 %d) !prof !0 {
+entry:
+  br i1 %c, label %left, label %right, !prof !1
+
+left:
+  %a = udiv i32 %x, %y
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %m = phi i32 [ %a, %left ], [ 0, %right ]
+  br i1 %d, label %use, label %exit, !prof !1
+
+use:
+  %b = udiv i32 %x, %y
+  br label %exit
+
+exit:
+  %r = phi i32 [ %m, %merge ], [ %b, %use ]
+  ret i32 %r
+}
+
+!0 = !{!"function_entry_count", i64 1000}
+!1 = !{!"branch_weights", i32 1000, i32 1}
+!2 = !{!"branch_weights", i32 1, i32 1000}
@@ -0,0 +1,113 @@
+; RUN: opt < %s -ssapre -ssapre-register-pressure -S | FileCheck %s
+; RUN: opt < %s -ssapre -ssapre-register-pressure -pass-remarks=ssapre -pass-remarks-missed=ssapre -disable-output 2>&1 | FileCheck %s --check-prefix=REMARK
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+; Few values are live across %mid, %b is replaced with %a
+; REMARK: redundancy is eliminated, the value is kept live into 2 more blocks within 8 registers
+; CHECK-LABEL: @low_pressure(
+; CHECK:       end:
+; CHECK-NOT:   add i32 %x, %y
+; CHECK:       ret
+define i32 @low_pressure(i32 %x, i32 %y) {
+entry:
+  %a = add i32 %x, %y
+  %a1 = mul i32 %a, 3
+  br label %mid
+
+mid:
+  br label %end
+
+end:
+  %b = add i32 %x, %y
+  %r = add i32 %a1, %b
+  ret i32 %r
+}
+
+; With the default eight registers %mid and %end are already full, keeping %a alive
+; across them would cause a spill
+; REMARK: redundancy is not eliminated, it would raise register pressure in end above 8
+; CHECK-LABEL: @high_pressure(
+; CHECK:       end:
+; CHECK-NEXT:  add i32 %x, %y
+; CHECK:       ret
+define i32 @high_pressure(i32 %x, i32 %y) {
+entry:
+  %a = add i32 %x, %y
+  %a1 = mul i32 %a, 3
+  %v1 = mul i32 %x, 11
+  %v2 = mul i32 %x, 12
+  %v3 = mul i32 %x, 13
+  %v4 = mul i32 %x, 14
+  %v5 = mul i32 %x, 15
+  %v6 = mul i32 %x, 16
+  %v7 = mul i32 %x, 17
+  br label %mid
+
+mid:
+  br label %end
+
+end:
+  %b = add i32 %x, %y
+  %s1 = add i32 %v1, %v2
+  %s2 = add i32 %s1, %v3
+  %s3 = add i32 %s2, %v4
+  %s4 = add i32 %s3, %v5
+  %s5 = add i32 %s4, %v6
+  %s6 = add i32 %s5, %v7
+  %s7 = add i32 %s6, %a1
+  %r = add i32 %s7, %b
+  ret i32 %r
+}
+
+; The PHI for %a and %d in %j1 would be live into the full %out, %j1 does not
+; get one and %d stays. The Factor in %j2 is not made available through it.
+; REMARK: redundancy is not eliminated, it would raise register pressure in out above 8
+; CHECK-LABEL: @factor_pressure(
+; CHECK:       j1:
+; CHECK-NOT:   phi
+; CHECK:       out:
+; CHECK-NEXT:  %d = add i32 %x, %y
+; CHECK:       ret
+define i32 @factor_pressure(i32 %x, i32 %y, i1 %c, i1 %c2) {
+entry:
+  %v1 = mul i32 %x, 11
+  %v2 = mul i32 %x, 12
+  %v3 = mul i32 %x, 13
+  %v4 = mul i32 %x, 14
+  %v5 = mul i32 %x, 15
+  %v6 = mul i32 %x, 16
+  %v7 = mul i32 %x, 17
+  br i1 %c, label %l, label %r
+
+l:
+  %a = add i32 %x, %y
+  call void @use(i32 %a)
+  br label %j1
+
+r:
+  br label %j1
+
+j1:
+  br i1 %c2, label %mid, label %out
+
+mid:
+  br label %j2
+
+out:
+  %d = add i32 %x, %y
+  call void @use(i32 %d)
+  br label %j2
+
+j2:
+  %b = add i32 %x, %y
+  %s1 = add i32 %v1, %v2
+  %s2 = add i32 %s1, %v3
+  %s3 = add i32 %s2, %v4
+  %s4 = add i32 %s3, %v5
+  %s5 = add i32 %s4, %v6
+  %s6 = add i32 %s5, %v7
+  %r1 = add i32 %s6, %b
+  ret i32 %r1
+}
+
+declare void @use(i32)
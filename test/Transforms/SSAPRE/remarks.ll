@@ -0,0 +1,88 @@
+; RUN: opt < %s -ssapre -pass-remarks=ssapre -pass-remarks-output=%t -disable-output 2>&1 | FileCheck %s
+; RUN: cat %t | FileCheck %s --check-prefix=YAML
+; RUN: opt < %s -ssapre -time-passes -disable-output 2>&1 | FileCheck %s --check-prefix=TIME
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;
+;       -------------                        -------------
+;         /       \                            /       \
+;  -------------  -------------  \\    -------------  -------------
+;   %b1 = %a+1                   //     %b1 = %a+1     %a+1
+;  -------------  -------------        -------------  -------------
+;         \       /                            \       /
+;       -------------                        -------------
+;        %b2 = %a+1                           phi
+;       -------------                        -------------
+; The insertion carries the location of the occurrence it is cloned from
+; CHECK:      remark: remarks.c:3:10: add inserted in right to make it fully redundant in merge{{$}}
+; CHECK-NEXT: remark: remarks.c:6:10: add eliminated, replaced by phi{{$}}
+; CHECK-NOT:  remark:
+
+; YAML:      --- !Passed
+; YAML-NEXT: Pass:            ssapre
+; YAML-NEXT: Name:            Inserted
+; YAML-NEXT: DebugLoc:        { File: remarks.c, Line: 3, Column: 10 }
+; YAML-NEXT: Function:        diamond
+; YAML-NEXT: Args:
+; YAML-NEXT:   - Instruction:     add
+; YAML-NEXT:     DebugLoc:        { File: remarks.c, Line: 3, Column: 10 }
+; YAML-NEXT:   - String:          ' inserted in '
+; YAML-NEXT:   - String:          right
+; YAML-NEXT:   - String:          ' to make it fully redundant in '
+; YAML-NEXT:   - String:          merge
+; YAML:      --- !Passed
+; YAML-NEXT: Pass:            ssapre
+; YAML-NEXT: Name:            Eliminated
+; YAML-NEXT: DebugLoc:        { File: remarks.c, Line: 6, Column: 10 }
+; YAML-NEXT: Function:        diamond
+
+; Every phase has its own timer
+; TIME:     SSAPRE Phases
+; TIME-DAG: StoreSinking
+; TIME-DAG: Init
+; TIME-DAG: FactorInsertion
+; TIME-DAG: Rename
+; TIME-DAG: DownSafety
+; TIME-DAG: WillBeAvail
+; TIME-DAG: Finalize
+; TIME-DAG: CodeMotion.FactorGraphWalkBottomUp
+; TIME-DAG: CodeMotion.FactorGraphWalkTopBottom
+; TIME-DAG: CodeMotion.PHIInsertion
+; TIME-DAG: CodeMotion.ApplySubstitutions
+; TIME-DAG: CodeMotion.KillEmAll
+define i32 @diamond(i32 %a, i1 %c) !dbg !7 {
+entry:
+  br i1 %c, label %left, label %right, !dbg !9
+
+left:
+  %b1 = add i32 %a, 1, !dbg !10
+  call void @use(i32 %b1), !dbg !11
+  br label %merge, !dbg !11
+
+right:
+  br label %merge, !dbg !12
+
+merge:
+  %b2 = add i32 %a, 1, !dbg !13
+  ret i32 %b2, !dbg !14
+}
+
+declare void @use(i32)
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: LineTablesOnly, enums: !2)
+!1 = !DIFile(filename: "remarks.c", directory: "/tmp")
+!2 = !{}
+!3 = !{i32 2, !"Dwarf Version", i32 4}
+!4 = !{i32 2, !"Debug Info Version", i32 3}
+!7 = distinct !DISubprogram(name: "diamond", scope: !1, file: !1, line: 1, type: !8, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: true, unit: !0, variables: !2)
+!8 = !DISubroutineType(types: !2)
+!9 = !DILocation(line: 2, column: 3, scope: !7)
+!10 = !DILocation(line: 3, column: 10, scope: !7)
+!11 = !DILocation(line: 4, column: 5, scope: !7)
+!12 = !DILocation(line: 5, column: 5, scope: !7)
+!13 = !DILocation(line: 6, column: 10, scope: !7)
+!14 = !DILocation(line: 6, column: 3, scope: !7)
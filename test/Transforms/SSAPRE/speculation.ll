@@ -0,0 +1,84 @@
+; RUN: opt < %s -ssapre -ssapre-speculate -S | FileCheck %s
+; RUN: opt < %s -ssapre -S | FileCheck %s --check-prefix=DEFAULT
+; RUN: opt < %s -ssapre -ssapre-speculate -ssapre-speculation-threshold=0 -S | FileCheck %s --check-prefix=DEFAULT
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;                                             %m = x * y
+;       -------------                        -------------
+;             |                                    |
+;       -------------  <-.                   -------------  <-.
+;        if (i < 10)     |                    if (i < 10)     |
+;       -------------    |           \\      -------------    |
+;        %m = x * y      |           //                       |
+;        use %m          |                    use %m          |
+;       -------------  --.                   -------------  --.
+; CHECK-LABEL: @spec_invariant(
+; CHECK:       entry:
+; CHECK-NEXT:  mul i32 %x, %y
+; CHECK:       then:
+; CHECK-NOT:   mul
+; CHECK:       ret
+; DEFAULT-LABEL: @spec_invariant(
+; DEFAULT:       entry:
+; DEFAULT-NOT:   mul
+; DEFAULT:       then:
+; DEFAULT-NEXT:  mul i32 %x, %y
+define i32 @spec_invariant(i32 %x, i32 %y, i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %c = icmp slt i32 %i, 10
+  br i1 %c, label %then, label %latch
+
+then:
+  %m = mul i32 %x, %y
+  %t = add i32 %s, %m
+  br label %latch
+
+latch:
+  %s.next = phi i32 [ %s, %header ], [ %t, %then ]
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %header, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+; A division may trap, it is never speculated
+; CHECK-LABEL: @spec_trap(
+; CHECK:       entry:
+; CHECK-NOT:   sdiv
+; CHECK:       then:
+; CHECK-NEXT:  sdiv i32 %x, %y
+; DEFAULT-LABEL: @spec_trap(
+; DEFAULT:       then:
+; DEFAULT-NEXT:  sdiv i32 %x, %y
+define i32 @spec_trap(i32 %x, i32 %y, i32 %n) {
+entry:
+  br label %header
+
+header:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %latch ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %latch ]
+  %c = icmp slt i32 %i, 10
+  br i1 %c, label %then, label %latch
+
+then:
+  %d = sdiv i32 %x, %y
+  %t = add i32 %s, %d
+  br label %latch
+
+latch:
+  %s.next = phi i32 [ %s, %header ], [ %t, %then ]
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %header, label %exit
+
+exit:
+  ret i32 %s.next
+}
@@ -0,0 +1,204 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s
+; RUN: opt < %s -passes='ssapre,print<memoryssa>' -verify-memoryssa \
+; RUN:   -disable-output 2>&1 | FileCheck %s --check-prefix=MSSA
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;  -------------  -------------            -------------  -------------
+;   store 0, %p    store 1, %p    \\
+;  -------------  -------------   //      -------------  -------------
+;         \       /                               \       /
+;       -------------                    ----------------------------
+;        %b = load %p                     phi(0, 1)
+;       -------------                     store phi, %p
+;                                         %b = load %p
+;                                        ----------------------------
+; CHECK-LABEL: @store_diamond(
+; CHECK:       left:
+; CHECK-NOT:   store i32
+; CHECK:       right:
+; CHECK-NOT:   store i32
+; CHECK:       merge:
+; CHECK-NEXT:  %storemerge = phi i32 [ 1, %right ], [ 0, %left ]
+; CHECK-NEXT:  store i32 %storemerge, i32* %p, align 4
+; CHECK-NEXT:  %b = load i32, i32* %p, align 4
+; MSSA-LABEL: @store_diamond(
+; MSSA:       merge:
+; MSSA-NEXT:  ; [[PHI:[0-9]+]] = MemoryPhi({left,liveOnEntry},{right,liveOnEntry})
+; MSSA:       ; [[DEF:[0-9]+]] = MemoryDef([[PHI]])
+; MSSA-NEXT:  store i32 %storemerge
+; MSSA-NEXT:  ; MemoryUse([[DEF]])
+; MSSA-NEXT:  %b = load i32
+define i32 @store_diamond(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 0, i32* %p, align 4
+  br label %merge
+
+right:
+  store i32 1, i32* %p, align 4
+  br label %merge
+
+merge:
+  %b = load i32, i32* %p, align 4
+  ret i32 %b
+}
+
+; The same value is stored on both sides, no PHI is needed
+; CHECK-LABEL: @store_diamond_same_value(
+; CHECK:       merge:
+; CHECK-NOT:   phi
+; CHECK-NEXT:  store i32 %x, i32* %p, align 4
+; CHECK-NOT:   store i32
+; CHECK:       ret
+define void @store_diamond_same_value(i32* %p, i32 %x, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 %x, i32* %p, align 4
+  br label %merge
+
+right:
+  store i32 %x, i32* %p, align 4
+  br label %merge
+
+merge:
+  ret void
+}
+
+; A store sunk into the inner join is sunk again into the outer one
+; CHECK-LABEL: @store_nested(
+; CHECK:       inner:
+; CHECK-NOT:   store i32
+; CHECK:       outer:
+; CHECK-NEXT:  %storemerge1 = phi i32 [ 3, %b ], [ %storemerge, %inner ]
+; CHECK-NEXT:  store i32 %storemerge1
+; CHECK-NOT:   store i32
+; CHECK:       ret
+define void @store_nested(i32* %p, i1 %c, i1 %d) {
+entry:
+  br i1 %c, label %a, label %b
+
+a:
+  br i1 %d, label %a1, label %a2
+
+a1:
+  store i32 1, i32* %p, align 4
+  br label %inner
+
+a2:
+  store i32 2, i32* %p, align 4
+  br label %inner
+
+inner:
+  br label %outer
+
+b:
+  store i32 3, i32* %p, align 4
+  br label %outer
+
+outer:
+  ret void
+}
+
+; Only one side stores, sinking would store on a path that did not
+; CHECK-LABEL: @store_one_side(
+; CHECK:       left:
+; CHECK-NEXT:  store
+; CHECK:       merge:
+; CHECK-NOT:   store i32
+; CHECK:       ret
+define void @store_one_side(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 0, i32* %p, align 4
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  ret void
+}
+
+; The stores go to different addresses
+; CHECK-LABEL: @store_different_address(
+; CHECK:       left:
+; CHECK-NEXT:  store i32 0, i32* %p
+; CHECK:       right:
+; CHECK-NEXT:  store i32 1, i32* %q
+; CHECK:       merge:
+; CHECK-NOT:   store i32
+; CHECK:       ret
+define void @store_different_address(i32* %p, i32* %q, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 0, i32* %p, align 4
+  br label %merge
+
+right:
+  store i32 1, i32* %q, align 4
+  br label %merge
+
+merge:
+  ret void
+}
+
+; A load after the store on one side must still see it
+; CHECK-LABEL: @store_then_load(
+; CHECK:       left:
+; CHECK-NEXT:  store i32 0, i32* %p
+; CHECK-NEXT:  load
+; CHECK:       right:
+; CHECK-NEXT:  store i32 1, i32* %p
+; CHECK:       merge:
+; CHECK-NOT:   store i32
+; CHECK:       ret
+define i32 @store_then_load(i32* %p, i32* %q, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store i32 0, i32* %p, align 4
+  %a = load i32, i32* %q, align 4
+  br label %merge
+
+right:
+  store i32 1, i32* %p, align 4
+  br label %merge
+
+merge:
+  %r = phi i32 [ %a, %left ], [ 0, %right ]
+  ret i32 %r
+}
+
+; Volatile stores stay where they are
+; CHECK-LABEL: @store_volatile(
+; CHECK:       left:
+; CHECK-NEXT:  store volatile
+; CHECK:       right:
+; CHECK-NEXT:  store volatile
+; CHECK:       merge:
+; CHECK-NOT:   store i32
+; CHECK:       ret
+define void @store_volatile(i32* %p, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  store volatile i32 0, i32* %p, align 4
+  br label %merge
+
+right:
+  store volatile i32 1, i32* %p, align 4
+  br label %merge
+
+merge:
+  ret void
+}
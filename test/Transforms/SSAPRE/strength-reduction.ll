@@ -0,0 +1,102 @@
+; RUN: opt < %s -ssapre -ssapre-strength-reduction -S | FileCheck %s
+; RUN: opt < %s -ssapre -S | FileCheck %s --check-prefix=DEFAULT
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;       -------------                        -------------
+;             |                                    |
+;       -------------  <-.           \\      ---------------  <-.
+;        %m = i * c      |           //       %m = phi(0, %m')  |
+;        i = i + 1       |                    %m' = %m + c      |
+;       -------------  --.                    i = i + 1         |
+;                                            ---------------  --.
+; CHECK-LABEL: @sr_invariant(
+; CHECK:       loop:
+; CHECK:       %i.sr = phi i32 [ 0, %entry ], [ %i.next.sr, %loop ]
+; CHECK-NOT:   mul
+; CHECK:       %i.next.sr = add i32 %i.sr, %c
+; CHECK:       ret
+; DEFAULT-LABEL: @sr_invariant(
+; DEFAULT:       mul i32 %i, %c
+define i32 @sr_invariant(i32 %c, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %m = mul i32 %i, %c
+  %s.next = add i32 %s, %m
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+; Both the step and the factor are constants, the update is folded
+; CHECK-LABEL: @sr_constant(
+; CHECK:       loop:
+; CHECK:       %i.sr = phi i64 [ 120, %entry ], [ %i.next.sr, %loop ]
+; CHECK-NOT:   mul
+; CHECK:       %i.next.sr = add i64 %i.sr, 24
+; CHECK:       ret
+define void @sr_constant(i8* %p, i64 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 10, %entry ], [ %i.next, %loop ]
+  %off = mul nsw i64 %i, 12
+  %a = getelementptr i8, i8* %p, i64 %off
+  store i8 0, i8* %a
+  %i.next = add nsw i64 %i, 2
+  %cmp = icmp slt i64 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+; A multiplicative induction is left alone
+; CHECK-LABEL: @sr_geometric(
+; CHECK:       mul i32 %i, %c
+; CHECK:       ret
+define i32 @sr_geometric(i32 %c, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 1, %entry ], [ %i.next, %loop ]
+  %s = phi i32 [ 0, %entry ], [ %s.next, %loop ]
+  %m = mul i32 %i, %c
+  %s.next = add i32 %s, %m
+  %i.next = mul i32 %i, 3
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %s.next
+}
+
+; The multiplication in the exit is executed once, it is left alone
+; CHECK-LABEL: @sr_exit(
+; CHECK-NOT:   .sr
+; CHECK:       exit:
+; CHECK-NEXT:  %m = mul i32 %i, %c
+; CHECK-NEXT:  ret i32 %m
+define i32 @sr_exit(i32 %c, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  %m = mul i32 %i, %c
+  ret i32 %m
+}
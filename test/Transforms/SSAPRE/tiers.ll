@@ -0,0 +1,64 @@
+; RUN: opt < %s -ssapre -S | FileCheck %s --check-prefix=FULL
+; RUN: opt < %s -ssapre -ssapre-tier-minimal-size=1 -ssapre-tier-hot-classes=1 -S | FileCheck %s --check-prefix=MINIMAL
+; RUN: opt < %s -ssapre -ssapre-tier-reduced-size=1 -pass-remarks-analysis=ssapre -disable-output 2>&1 | FileCheck %s --check-prefix=REDUCED-REMARK
+; RUN: opt < %s -ssapre -ssapre-tier-minimal-size=1 -ssapre-tier-hot-classes=1 -pass-remarks-analysis=ssapre -disable-output 2>&1 | FileCheck %s --check-prefix=MINIMAL-REMARK
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;
+;       -------------                        -------------
+;         /       \                            /       \
+;  -------------  -------------  \\    -------------  -------------
+;   %b1 = %a+1                   //     %b1 = %a+1     %a+1
+;   %m1 = %a*%x                         %m1 = %a*%x    %a*%x(full tier only)
+;  -------------  -------------        -------------  -------------
+;         \       /                            \       /
+;       -------------                        -------------
+;        %b2 = %a+1                           phi
+;        %b3 = %a+1                           phi or %m2 = %a*%x
+;        %m2 = %a*%x
+;       -------------                        -------------
+; In the minimal tier only the most frequent class, the add, gets Factors, the
+; multiplication is left as it is
+; REDUCED-REMARK: remark: <unknown>:0:0: function has {{[0-9]+}} instructions and {{[0-9]+}} expression classes, existing PHIs are not factored and nothing is speculated{{$}}
+; MINIMAL-REMARK: remark: <unknown>:0:0: function has {{[0-9]+}} instructions and {{[0-9]+}} expression classes, existing PHIs are not factored and nothing is speculated, cycles are ignored and only 1 classes get Factors
+; FULL-LABEL: @hot_and_cold(
+; FULL:       right:
+; FULL:       add i32 %a, 1
+; FULL:       mul i32 %a, %x
+; FULL:       merge:
+; FULL-NOT:   add i32 %a, 1
+; FULL-NOT:   mul
+; FULL:       ret
+; MINIMAL-LABEL: @hot_and_cold(
+; MINIMAL:       right:
+; MINIMAL-NEXT:  add i32 %a, 1
+; MINIMAL-NEXT:  br label %merge
+; MINIMAL:       merge:
+; MINIMAL-NOT:   add i32 %a, 1
+; MINIMAL:       mul i32 %a, %x
+; MINIMAL:       ret
+define i32 @hot_and_cold(i32 %a, i32 %x, i1 %c) {
+entry:
+  br i1 %c, label %left, label %right
+
+left:
+  %b1 = add i32 %a, 1
+  %m1 = mul i32 %a, %x
+  call void @use(i32 %b1)
+  call void @use(i32 %m1)
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %b2 = add i32 %a, 1
+  %b3 = add i32 %a, 1
+  %m2 = mul i32 %a, %x
+  %r1 = xor i32 %b2, %b3
+  %r2 = xor i32 %r1, %m2
+  ret i32 %r2
+}
+
+declare void @use(i32)
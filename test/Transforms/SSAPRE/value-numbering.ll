@@ -0,0 +1,66 @@
+; RUN: opt < %s -ssapre -ssapre-value-numbering -S | FileCheck %s
+; RUN: opt < %s -ssapre -S | FileCheck %s --check-prefix=LEXICAL
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+;       -------------                        -------------
+;        %x1 = %a*%b                          %x1 = %a*%b
+;       -------------                        -------------
+;         /       \                            /       \
+;  -------------  -------------  \\    -------------  -------------
+;   %s1 = %x1+%y                 //     %s1 = %x1+%y   %x1+%y
+;  -------------  -------------        -------------  -------------
+;         \       /                            \       /
+;       -------------                        -------------
+;        %x2 = %a*%b                          phi
+;        %s2 = %x2+%y
+;       -------------                        -------------
+; %x2 is congruent to %x1, so %s2 is in the class of %s1
+; CHECK-LABEL: @congruent_operands(
+; CHECK:       right:
+; CHECK-NEXT:  add i32 %x1, %y
+; CHECK:       merge:
+; CHECK:       phi
+; CHECK-NOT:   mul
+; CHECK-NOT:   add
+; CHECK:       ret
+; LEXICAL-LABEL: @congruent_operands(
+; LEXICAL:       right:
+; LEXICAL-NEXT:  br label %merge
+; LEXICAL:       merge:
+; LEXICAL-NOT:   mul
+; LEXICAL:       add i32 %x1, %y
+; LEXICAL:       ret
+define i32 @congruent_operands(i32 %a, i32 %b, i32 %y, i1 %c) {
+entry:
+  %x1 = mul i32 %a, %b
+  br i1 %c, label %left, label %right
+
+left:
+  %s1 = add i32 %x1, %y
+  call void @use(i32 %s1)
+  br label %merge
+
+right:
+  br label %merge
+
+merge:
+  %x2 = mul i32 %a, %b
+  %s2 = add i32 %x2, %y
+  ret i32 %s2
+}
+
+; %z simplifies to 0, and with it %w to %y
+; CHECK-LABEL: @simplified_operand(
+; CHECK-NOT:   sub
+; CHECK-NOT:   add
+; CHECK:       ret i32 %y
+; LEXICAL-LABEL: @simplified_operand(
+; LEXICAL:       add i32 0, %y
+define i32 @simplified_operand(i32 %a, i32 %y) {
+entry:
+  %z = sub i32 %a, %a
+  %w = add i32 %z, %y
+  ret i32 %w
+}
+
+declare void @use(i32)
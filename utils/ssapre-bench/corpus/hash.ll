@@ -0,0 +1,63 @@
+; A string hash with a branch per character, both sides and the join compute
+; the same mixing step, the way it looks after inlining a helper into both arms
+; of a conditional.
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+@text = private constant [44 x i8] c"the quick brown fox jumps over the lazy dog\00"
+
+define internal i32 @hash(i32 %seed) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %i.n, %join ]
+  %h = phi i32 [ %seed, %entry ], [ %h.n, %join ]
+  %p = getelementptr inbounds [44 x i8], [44 x i8]* @text, i64 0, i64 %i
+  %ch = load i8, i8* %p
+  %done = icmp eq i8 %ch, 0
+  br i1 %done, label %exit, label %body
+
+body:
+  %c = zext i8 %ch to i32
+  %vowel = icmp ult i8 %ch, 104
+  br i1 %vowel, label %low, label %high
+
+low:
+  %m.l = mul i32 %h, 33
+  %x.l = xor i32 %m.l, %c
+  br label %join
+
+high:
+  %s.h = shl i32 %c, 3
+  br label %join
+
+join:
+  %t = phi i32 [ %x.l, %low ], [ %s.h, %high ]
+  %m = mul i32 %h, 33
+  %x = xor i32 %m, %c
+  %h.n = add i32 %x, %t
+  %i.n = add i64 %i, 1
+  br label %loop
+
+exit:
+  ret i32 %h
+}
+
+define i32 @main() {
+entry:
+  br label %loop
+
+loop:
+  %j = phi i32 [ 0, %entry ], [ %j.n, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.n, %loop ]
+  %r = call i32 @hash(i32 %j)
+  %sum.m = mul i32 %sum, 31
+  %sum.n = add i32 %sum.m, %r
+  %j.n = add i32 %j, 1
+  %c = icmp slt i32 %j.n, 256
+  br i1 %c, label %loop, label %exit
+
+exit:
+  %ret = and i32 %sum.n, 255
+  ret i32 %ret
+}
@@ -0,0 +1,102 @@
+; Matrix multiplication over global arrays, the address computations of the
+; inner loop are partially redundant with the ones of the accumulation and the
+; row offsets are loop invariant.
+target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-v128:128:128-a0:0:64-n8:16:32:64"
+
+@A = internal global [256 x i32] zeroinitializer
+@B = internal global [256 x i32] zeroinitializer
+@C = internal global [256 x i32] zeroinitializer
+
+define internal void @init() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %loop ]
+  %idx = sext i32 %i to i64
+  %pa = getelementptr inbounds [256 x i32], [256 x i32]* @A, i64 0, i64 %idx
+  %pb = getelementptr inbounds [256 x i32], [256 x i32]* @B, i64 0, i64 %idx
+  %va = mul i32 %i, 7
+  %vb = xor i32 %i, 93
+  store i32 %va, i32* %pa
+  store i32 %vb, i32* %pb
+  %i.n = add i32 %i, 1
+  %c = icmp slt i32 %i.n, 256
+  br i1 %c, label %loop, label %exit
+
+exit:
+  ret void
+}
+
+define internal void @matmul() {
+entry:
+  br label %rows
+
+rows:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %rows.latch ]
+  br label %cols
+
+cols:
+  %j = phi i32 [ 0, %rows ], [ %j.n, %cols.latch ]
+  br label %inner
+
+inner:
+  %k = phi i32 [ 0, %cols ], [ %k.n, %inner ]
+  %sum = phi i32 [ 0, %cols ], [ %sum.n, %inner ]
+  %row.a = mul i32 %i, 16
+  %ia = add i32 %row.a, %k
+  %ia.64 = sext i32 %ia to i64
+  %pa = getelementptr inbounds [256 x i32], [256 x i32]* @A, i64 0, i64 %ia.64
+  %a = load i32, i32* %pa
+  %row.b = mul i32 %k, 16
+  %ib = add i32 %row.b, %j
+  %ib.64 = sext i32 %ib to i64
+  %pb = getelementptr inbounds [256 x i32], [256 x i32]* @B, i64 0, i64 %ib.64
+  %b = load i32, i32* %pb
+  %p = mul i32 %a, %b
+  %sum.n = add i32 %sum, %p
+  %k.n = add i32 %k, 1
+  %ck = icmp slt i32 %k.n, 16
+  br i1 %ck, label %inner, label %cols.latch
+
+cols.latch:
+  %row.c = mul i32 %i, 16
+  %ic = add i32 %row.c, %j
+  %ic.64 = sext i32 %ic to i64
+  %pc = getelementptr inbounds [256 x i32], [256 x i32]* @C, i64 0, i64 %ic.64
+  store i32 %sum.n, i32* %pc
+  %j.n = add i32 %j, 1
+  %cj = icmp slt i32 %j.n, 16
+  br i1 %cj, label %cols, label %rows.latch
+
+rows.latch:
+  %i.n = add i32 %i, 1
+  %ci = icmp slt i32 %i.n, 16
+  br i1 %ci, label %rows, label %exit
+
+exit:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  call void @init()
+  call void @matmul()
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.n, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum.n, %loop ]
+  %idx = sext i32 %i to i64
+  %pc = getelementptr inbounds [256 x i32], [256 x i32]* @C, i64 0, i64 %idx
+  %c = load i32, i32* %pc
+  %sum.m = mul i32 %sum, 31
+  %sum.n = add i32 %sum.m, %c
+  %i.n = add i32 %i, 1
+  %ci = icmp slt i32 %i.n, 256
+  br i1 %ci, label %loop, label %exit
+
+exit:
+  %ret = and i32 %sum.n, 255
+  ret i32 %ret
+}
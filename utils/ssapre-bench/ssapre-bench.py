@@ -0,0 +1,517 @@
+#!/usr/bin/env python
+"""SSAPRE benchmark harness.
+
+Runs opt with SSAPRE, GVN, NewGVN and the -O2 pipeline over a corpus of
+generated and hand-written IR and reports for every input and pass:
+
+  pass(ms)  wall time of the pass itself, from -time-passes
+  opt(ms)   wall time of the whole opt invocation
+  rss(KB)   peak resident set size of opt
+  static    number of instructions in the output
+  dynamic   number of instructions executed by lli on the output
+
+The generated inputs come in four kinds(diamonds, loop nests, switch
+interpreters and post-inline bloat) at increasing sizes, the hand-written ones
+are the .ll files of the corpus directory. Every input has a main that returns
+a checksum, the outputs of all passes must return the same one as the input.
+
+The dynamic count comes from a counter added to the output: every block adds
+its number of instructions to a global, main is wrapped to print the total.
+Running it needs lli, by default the one next to opt. A build of only the opt
+target does not have it, build lli as well(make opt lli) or pass the lli of
+another LLVM installation that reads this IR with --lli.
+
+The pipeline is run as o2 and as o2-ssapre, without and with -enable-ssapre.
+
+Example:
+  ssapre-bench.py --bindir=build/bin --sizes=1,4,16
+  ssapre-bench.py --bindir=build/bin --lli=/usr/bin/lli
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+DATALAYOUT = ('target datalayout = "e-p:64:64:64-p1:16:16:16-i1:8:8-i8:8:8-'
+              'i16:16:16-i32:32:32-i64:32:64-f32:32:32-f64:64:64-v64:64:64-'
+              'v128:128:128-a0:0:64-n8:16:32:64"')
+
+# Options of opt and the names the pass goes by in the -time-passes report, of
+# the legacy and of the new pass manager. For the pipelines pass(ms) is the time
+# of SSAPRE within them, the cost of the whole pipeline is in opt(ms).
+PASSES = {
+  'ssapre':    (['-ssapre'],
+                ['SSA Partial Redundancy Elimination', 'SSAPRE']),
+  'gvn':       (['-gvn'], ['Global Value Numbering', 'GVN', 'GVNPass']),
+  'newgvn':    (['-newgvn'],
+                ['Global Value Numbering', 'NewGVN', 'NewGVNPass']),
+  'o2':        (['-O2'], []),
+  'o2-ssapre': (['-O2', '-enable-ssapre'],
+                ['SSA Partial Redundancy Elimination', 'SSAPRE']),
+}
+
+# Calls to the kernel from main
+ITERATIONS = 64
+
+
+def main_calling(args):
+  """main calls the kernel ITERATIONS times and folds the results. The
+  arguments derive from @seed, which main reads with a volatile load, so that
+  -O2 cannot fold the kernel away."""
+  lines = ['@seed = global i32 0',
+           '',
+           'define i32 @main() {',
+           'entry:',
+           '  %seed = load volatile i32, i32* @seed',
+           '  %trip = add i32 %seed, 3',
+           '  br label %loop',
+           'loop:',
+           '  %it = phi i32 [ 0, %entry ], [ %it.n, %loop ]',
+           '  %j = phi i32 [ %seed, %entry ], [ %j.n, %loop ]',
+           '  %sum = phi i32 [ 0, %entry ], [ %sum.n, %loop ]',
+           '  %j3 = mul i32 %j, 3',
+           '  %%r = call i32 @kernel(%s)' % args,
+           '  %sum.m = mul i32 %sum, 31',
+           '  %sum.n = add i32 %sum.m, %r',
+           '  %j.n = add i32 %j, 1',
+           '  %it.n = add i32 %it, 1',
+           '  %%c = icmp slt i32 %%it.n, %d' % ITERATIONS,
+           '  br i1 %c, label %loop, label %exit',
+           'exit:',
+           '  %ret = and i32 %sum.n, 255',
+           '  ret i32 %ret',
+           '}']
+  return lines
+
+
+def gen_diamonds(n):
+  """A chain of n diamonds, one side and the join compute the same chain."""
+  lines = ['define i32 @kernel(i32 %x, i32 %b) {', 'entry:',
+           '  br label %d0']
+  for i in range(n):
+    v = '%%v%d' % i if i else '%x'
+    lines += ['d%d:' % i,
+              '  %%c%d.a = and i32 %s, %d' % (i, v, 1 << (i % 8)),
+              '  %%c%d = icmp eq i32 %%c%d.a, 0' % (i, i),
+              '  br i1 %%c%d, label %%l%d, label %%m%d' % (i, i, i),
+              'l%d:' % i,
+              '  %%p%d.l = add i32 %%x, %d' % (i, i),
+              '  %%q%d.l = mul i32 %%p%d.l, %%b' % (i, i),
+              '  %%w%d.l = add i32 %s, %%q%d.l' % (i, v, i),
+              '  br label %%m%d' % i,
+              'm%d:' % i,
+              '  %%w%d = phi i32 [ %%w%d.l, %%l%d ], [ %s, %%d%d ]'
+              % (i, i, i, v, i),
+              '  %%p%d.m = add i32 %%x, %d' % (i, i),
+              '  %%q%d.m = mul i32 %%p%d.m, %%b' % (i, i),
+              '  %%v%d = xor i32 %%w%d, %%q%d.m' % (i + 1, i, i),
+              '  br label %%d%d' % (i + 1)]
+  lines += ['d%d:' % n, '  ret i32 %%v%d' % n, '}']
+  return lines + main_calling('i32 %j, i32 %j3')
+
+
+def gen_loops(n):
+  """A nest of loops with loop invariant and fully redundant computations at
+  every level and a partially redundant diamond in the innermost one. The trip
+  count is an argument, three at run time. The depth grows with the logarithm
+  of n, the trip count of the innermost loop is exponential in it."""
+  depth = 2 + n.bit_length() - 1
+
+  def loop(k, pred, acc, exit):
+    lines = ['h%d:' % k,
+             '  %%i%d = phi i32 [ 0, %%%s ], [ %%i%d.n, %%l%d ]'
+             % (k, pred, k, k),
+             '  %%acc%d = phi i32 [ %s, %%%s ], [ %%acc%d.l, %%l%d ]'
+             % (k, acc, pred, k, k),
+             '  %%e%d.h = add i32 %%i%d, %%a' % (k, k)]
+    if k + 1 < depth:
+      lines += ['  br label %%h%d' % (k + 1)]
+      lines += loop(k + 1, 'h%d' % k, '%%acc%d' % k, 'l%d' % k)
+      out = '%%acc%d.l' % (k + 1)
+    else:
+      lines += ['  %inv = mul i32 %a, %b',
+                '  %%t = add i32 %%inv, %%e%d.h' % k,
+                '  %%odd.t = and i32 %%i%d, 1' % k,
+                '  %is.odd = icmp ne i32 %odd.t, 0',
+                '  br i1 %is.odd, label %odd, label %join',
+                'odd:',
+                '  %u.o = mul i32 %t, %b',
+                '  br label %join',
+                'join:',
+                '  %%u.p = phi i32 [ %%u.o, %%odd ], [ 0, %%h%d ]' % k,
+                '  %u.j = mul i32 %t, %b',
+                '  %%acc.p = add i32 %%acc%d, %%u.p' % k,
+                '  %acc.in = add i32 %acc.p, %u.j',
+                '  br label %%l%d' % k]
+      out = '%acc.in'
+    lines += ['l%d:' % k,
+              '  %%e%d.l = add i32 %%i%d, %%a' % (k, k),
+              '  %%acc%d.l = add i32 %s, %%e%d.l' % (k, out, k),
+              '  %%i%d.n = add i32 %%i%d, 1' % (k, k),
+              '  %%c%d = icmp slt i32 %%i%d.n, %%n' % (k, k),
+              '  br i1 %%c%d, label %%h%d, label %%%s' % (k, k, exit)]
+    return lines
+
+  lines = ['define i32 @kernel(i32 %a, i32 %b, i32 %n) {', 'entry:',
+           '  br label %h0']
+  lines += loop(0, 'entry', '0', 'exit')
+  lines += ['exit:', '  ret i32 %acc0.l', '}']
+  return lines + main_calling('i32 %j, i32 %j3, i32 %trip')
+
+
+def gen_switch(n):
+  """A bytecode interpreter with 4*n opcodes, every opcode computes what the
+  dispatch loop computes again after the switch."""
+  ops = 4 * n
+  # A fixed pseudo-random program, the same for every run of the harness
+  code, seed = [], 12345
+  for _ in range(64):
+    seed = (seed * 1103515245 + 12345) % (1 << 31)
+    code.append(seed % (ops + 1))
+  lines = ['@code = private constant [64 x i32] [%s]'
+           % ', '.join('i32 %d' % c for c in code), '',
+           'define i32 @kernel(i32 %seed, i32 %x) {',
+           'entry:',
+           '  br label %loop',
+           'loop:',
+           '  %pc = phi i32 [ 0, %entry ], [ %pc.n, %next ]',
+           '  %acc = phi i32 [ %seed, %entry ], [ %acc.x, %next ]',
+           '  %idx = and i32 %pc, 63',
+           '  %p = getelementptr inbounds [64 x i32], [64 x i32]* @code, '
+           'i32 0, i32 %idx',
+           '  %op = load i32, i32* %p',
+           '  switch i32 %op, label %next ['] + \
+          ['    i32 %d, label %%op%d' % (k, k) for k in range(ops)] + ['  ]']
+  for k in range(ops):
+    lines += ['op%d:' % k,
+              '  %%k%d.1 = mul i32 %%acc, %%x' % k,
+              '  %%k%d.2 = add i32 %%k%d.1, %d' % (k, k, k + 1),
+              '  br label %next']
+  lines += ['next:',
+            '  %%acc.n = phi i32 [ %%acc, %%loop ], %s'
+            % ', '.join('[ %%k%d.2, %%op%d ]' % (k, k) for k in range(ops)),
+            '  %m = mul i32 %acc, %x',
+            '  %acc.x = xor i32 %acc.n, %m',
+            '  %pc.n = add i32 %pc, 1',
+            '  %c = icmp slt i32 %pc.n, 256',
+            '  br i1 %c, label %loop, label %exit',
+            'exit:',
+            '  ret i32 %acc.x',
+            '}']
+  return lines + main_calling('i32 %j, i32 %j3')
+
+
+def gen_inline(n):
+  """n conditionally inlined copies of the same helper, as left behind by the
+  inliner, each followed by a leftover of its first computation."""
+  lines = ['define i32 @kernel(i32 %x, i32 %a, i32 %b) {', 'entry:',
+           '  br label %s0']
+  for i in range(n):
+    v = '%%v%d' % i if i else '%x'
+    lines += ['s%d:' % i,
+              '  %%c%d.t = and i32 %s, 1' % (i, v),
+              '  %%c%d = icmp eq i32 %%c%d.t, 0' % (i, i),
+              '  br i1 %%c%d, label %%in%d, label %%j%d' % (i, i, i),
+              'in%d:' % i,
+              '  %%h%d.1 = mul i32 %%x, %%a' % i,
+              '  %%h%d.2 = add i32 %%h%d.1, %%b' % (i, i),
+              '  %%h%d.3 = xor i32 %%h%d.2, %%h%d.1' % (i, i, i),
+              '  %%h%d.4 = shl i32 %%h%d.3, 1' % (i, i),
+              '  br label %%j%d' % i,
+              'j%d:' % i,
+              '  %%g%d = phi i32 [ %%h%d.4, %%in%d ], [ %s, %%s%d ]'
+              % (i, i, i, v, i),
+              '  %%h%d.5 = mul i32 %%x, %%a' % i,
+              '  %%v%d = add i32 %%g%d, %%h%d.5' % (i + 1, i, i),
+              '  br label %%s%d' % (i + 1)]
+  lines += ['s%d:' % n, '  ret i32 %%v%d' % n, '}']
+  return lines + main_calling('i32 %j, i32 %j3, i32 7')
+
+
+GENERATORS = {
+  'diamonds': gen_diamonds,
+  'loops':    gen_loops,
+  'switch':   gen_switch,
+  'inline':   gen_inline,
+}
+
+
+def is_label(line):
+  return re.match(r'^[-\w.$]+:', line) is not None
+
+
+def split_functions(text):
+  """Yield (header, body lines) for every function definition and the lines
+  outside of definitions as (None, [line])."""
+  lines = text.splitlines()
+  i = 0
+  while i < len(lines):
+    if lines[i].startswith('define '):
+      j = i + 1
+      while lines[j] != '}':
+        j += 1
+      yield lines[i], lines[i + 1:j]
+      i = j + 1
+    else:
+      yield None, [lines[i]]
+      i += 1
+
+
+def split_blocks(body):
+  """Split a function body into blocks, each a (label line, instructions)
+  pair, an instruction being the list of its lines."""
+  blocks = [[None, []]]
+  insn = None
+  for line in body:
+    stripped = line.strip()
+    if not stripped or stripped.startswith(';'):
+      continue
+    if insn is not None:
+      # Inside of the bracketed tail of a switch or an indirectbr
+      insn.append(line)
+      if stripped == ']':
+        insn = None
+      continue
+    if is_label(line):
+      blocks.append([line, []])
+      continue
+    blocks[-1][1].append([line])
+    if stripped.endswith('['):
+      insn = blocks[-1][1][-1]
+  return [b for b in blocks if b[0] is not None or b[1]]
+
+
+def count_static(text):
+  return sum(len(insns) for header, body in split_functions(text) if header
+             for label, insns in split_blocks(body))
+
+
+def instrument(text):
+  """Add the counter to every block and wrap main."""
+  out = []
+  for header, body in split_functions(text):
+    if header is None:
+      out += body
+      continue
+    if header.startswith('define i32 @main('):
+      header = header.replace('@main(', '@__ssapre_bench_main(', 1)
+    out.append(header)
+    for label, insns in split_blocks(body):
+      if label is not None:
+        out.append(label)
+      # After the PHIs and the landing pads, they have to come first
+      first = 0
+      while first < len(insns) and re.search(r'= (phi|landingpad) ',
+                                             insns[first][0]):
+        first += 1
+      for k, insn in enumerate(insns):
+        if k == first:
+          out.append('  call void @__ssapre_bench_count(i64 %d)' % len(insns))
+        out += insn
+    out.append('}')
+  out += ['',
+          '@__ssapre_bench_dyn = internal global i64 0',
+          '@__ssapre_bench_fmt = private constant [20 x i8] '
+          'c"dynamic-insts: %ld\\0A\\00"',
+          '',
+          'define internal void @__ssapre_bench_count(i64 %n) {',
+          '  %c = load i64, i64* @__ssapre_bench_dyn',
+          '  %s = add i64 %c, %n',
+          '  store i64 %s, i64* @__ssapre_bench_dyn',
+          '  ret void',
+          '}',
+          '',
+          'define i32 @main() {',
+          '  %r = call i32 @__ssapre_bench_main()',
+          '  %c = load i64, i64* @__ssapre_bench_dyn',
+          '  %f = getelementptr [20 x i8], [20 x i8]* @__ssapre_bench_fmt, '
+          'i64 0, i64 0',
+          '  call i32 (i8*, ...) @printf(i8* %f, i64 %c)',
+          '  ret i32 %r',
+          '}']
+  if not re.search(r'^declare .*@printf\(', text, re.M):
+    out.append('declare i32 @printf(i8*, ...)')
+  return '\n'.join(out) + '\n'
+
+
+def run(cmd):
+  """Run cmd and return (exit code, stdout, stderr, wall seconds, peak RSS in
+  KB)."""
+  with tempfile.TemporaryFile('w+') as out, tempfile.TemporaryFile('w+') as err:
+    start = time.time()
+    p = subprocess.Popen(cmd, stdout=out, stderr=err)
+    # wait4 rather than wait, it has the resource usage of this very child
+    _, status, usage = os.wait4(p.pid, 0)
+    wall = time.time() - start
+    out.seek(0)
+    err.seek(0)
+    if os.WIFSIGNALED(status):
+      rc = -os.WTERMSIG(status)
+    else:
+      rc = os.WEXITSTATUS(status)
+    return rc, out.read(), err.read(), wall, usage.ru_maxrss
+
+
+def pass_time(report, names):
+  """Sum the wall times of the passes called names in a -time-passes report."""
+  total = 0.0
+  found = False
+  for line in report.splitlines():
+    m = re.match(r'^\s*(.*\))\s+(\S.*?)\s*$', line)
+    if not m or m.group(2) not in names:
+      continue
+    times = re.findall(r'([0-9.]+) \(\s*[0-9.]+%\)', m.group(1))
+    if times:
+      # User, system, user+system and wall, the last one is the wall time
+      total += float(times[-1])
+      found = True
+  return total if found else None
+
+
+def measure(args, name, path, pass_name):
+  """Measure one pass on one input, pass_name None being the input itself."""
+  if pass_name is None:
+    with open(path) as f:
+      output = f.read()
+    result = {'pass': '-', 'opt': None, 'rss': None}
+  else:
+    options, names = PASSES[pass_name]
+    best = None
+    for _ in range(args.repeat):
+      rc, out, err, wall, rss = run([args.opt] + options +
+                                    ['-time-passes', '-S', path])
+      if rc != 0:
+        sys.stderr.write('%s %s failed:\n%s' % (' '.join(options), name, err))
+        return None
+      sample = (wall, pass_time(err, names), rss, out)
+      if best is None or sample[0] < best[0]:
+        best = sample
+    wall, ptime, rss, output = best
+    result = {'pass': ptime, 'opt': wall, 'rss': rss}
+  result['static'] = count_static(output)
+
+  counted = os.path.join(args.workdir, '%s.%s.count.ll'
+                         % (name, pass_name or 'input'))
+  with open(counted, 'w') as f:
+    f.write(instrument(output))
+  rc, out, err, _, _ = run([args.lli, counted])
+  m = re.search(r'^dynamic-insts: (\d+)$', out, re.M)
+  result['dynamic'] = int(m.group(1)) if m else None
+  result['exit'] = rc
+  return result
+
+
+def inputs(args):
+  """Yield the (name, path) of every input, writing the generated ones."""
+  for kind in args.kinds:
+    for size in args.sizes:
+      name = '%s-%d' % (kind, size)
+      path = os.path.join(args.workdir, name + '.ll')
+      with open(path, 'w') as f:
+        f.write('; %s, generated by ssapre-bench.py\n' % name)
+        f.write(DATALAYOUT + '\n\n')
+        f.write('\n'.join(GENERATORS[kind](size)) + '\n')
+      yield name, path
+  if args.corpus:
+    for file in sorted(os.listdir(args.corpus)):
+      if file.endswith('.ll'):
+        yield file[:-3], os.path.join(args.corpus, file)
+
+
+def fmt(value, scale=1, digits=0):
+  if value is None:
+    return '-'
+  return '%.*f' % (digits, value * scale)
+
+
+def main():
+  here = os.path.dirname(os.path.abspath(__file__))
+  parser = argparse.ArgumentParser(
+      description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--bindir', default='',
+                      help='Directory of opt and lli(default: PATH)')
+  parser.add_argument('--lli', default='',
+                      help='lli to run the outputs with(default: the one in '
+                           '--bindir)')
+  parser.add_argument('--sizes', default='1,4,16,64',
+                      help='Comma separated sizes of the generated inputs')
+  parser.add_argument('--kinds', default=','.join(sorted(GENERATORS)),
+                      help='Comma separated kinds of the generated inputs')
+  parser.add_argument('--passes', default='ssapre,gvn,newgvn,o2,o2-ssapre',
+                      help='Comma separated passes to compare, out of %s'
+                           % ','.join(sorted(PASSES)))
+  parser.add_argument('--corpus', default=os.path.join(here, 'corpus'),
+                      help='Directory of the hand-written inputs, empty for '
+                           'none')
+  parser.add_argument('--repeat', type=int, default=3,
+                      help='Runs of opt per measurement, the fastest counts')
+  parser.add_argument('--csv', action='store_true',
+                      help='Print comma separated values instead of a table')
+  parser.add_argument('--keep', action='store_true',
+                      help='Keep the inputs and the instrumented outputs')
+  args = parser.parse_args()
+
+  args.opt = os.path.join(args.bindir, 'opt')
+  args.lli = args.lli or os.path.join(args.bindir, 'lli')
+  for tool in (args.opt, args.lli):
+    if os.path.dirname(tool) and not os.path.isfile(tool):
+      parser.error('%s not found, opt and lli are required' % tool)
+  args.sizes = [int(s) for s in args.sizes.split(',') if s]
+  args.kinds = [k for k in args.kinds.split(',') if k]
+  passes = [p for p in args.passes.split(',') if p]
+  for k in args.kinds:
+    if k not in GENERATORS:
+      parser.error('unknown kind %s' % k)
+  for p in passes:
+    if p not in PASSES:
+      parser.error('unknown pass %s' % p)
+  args.workdir = tempfile.mkdtemp(prefix='ssapre-bench.')
+
+  columns = ['input', 'pass', 'pass(ms)', 'opt(ms)', 'rss(KB)', 'static',
+             'dynamic', 'check']
+  rows = []
+  failed = False
+  try:
+    for name, path in inputs(args):
+      base = measure(args, name, path, None)
+      rows.append([name, '-', '-', '-', '-', str(base['static']),
+                   fmt(base['dynamic']), 'exit %d' % base['exit']])
+      for p in passes:
+        r = measure(args, name, path, p)
+        if r is None:
+          failed = True
+          continue
+        ok = r['exit'] == base['exit'] and r['dynamic'] is not None
+        failed |= not ok
+        rows.append([name, p, fmt(r['pass'], 1000, 2), fmt(r['opt'], 1000, 1),
+                     fmt(r['rss']), str(r['static']), fmt(r['dynamic']),
+                     'ok' if ok else 'MISMATCH'])
+  finally:
+    if args.keep:
+      print('inputs and outputs are kept in %s' % args.workdir,
+            file=sys.stderr)
+    else:
+      shutil.rmtree(args.workdir)
+
+  if args.csv:
+    print(','.join(columns))
+    for row in rows:
+      print(','.join(row))
+  else:
+    widths = [max(len(r[i]) for r in rows + [columns])
+              for i in range(len(columns))]
+    for row in [columns] + rows:
+      print('  '.join(c.ljust(w) if i < 2 else c.rjust(w)
+                      for i, (c, w) in enumerate(zip(row, widths))))
+  return 1 if failed else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())